@@ -0,0 +1,77 @@
+#pragma once
+
+#include "utils/bytes.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Decoder of the sequential DCT scan coded with the arithmetic coder
+ * of ITU T.81 (SOF9), e.g. the output of `jpegtran -arithmetic`.
+ *
+ * The probability estimation follows the packed state table of Annex D,
+ * so every decoded decision costs one table lookup.
+ */
+class ArithmeticScanDecoder
+{
+public:
+    /**
+     * @param next_byte Returns the next byte of the scan with the stuffing
+     * removed, zeros when the marker after the scan is reached.
+     */
+    explicit ArithmeticScanDecoder(std::function<Byte()> next_byte);
+
+    /** Sets the bounds of DC difference classes of DAC segment. */
+    void set_dc_conditioning(std::size_t table_id, Byte lower, Byte upper);
+
+    /** Sets the threshold of AC magnitude classes of DAC segment. */
+    void set_ac_conditioning(std::size_t table_id, Byte threshold);
+
+    /**
+     * @brief Resets the statistics and the state of the decoder at the start
+     * of the scan and after every restart marker.
+     */
+    void reset(std::size_t components_count);
+
+    /**
+     * @brief Decodes the difference of the DC coefficient of the component
+     * with its prediction.
+     */
+    int decode_dc_difference(std::size_t component_index, std::size_t table_id);
+
+    /**
+     * @brief Decodes the AC coefficients to the positions 1..63 of the block
+     * in zigzag order.
+     */
+    void decode_ac(std::array<int, 64> & block, std::size_t table_id);
+
+private:
+    inline static constexpr std::size_t TablesCount = 4;
+    inline static constexpr std::size_t DCStatisticsSize = 64;
+    inline static constexpr std::size_t ACStatisticsSize = 256;
+    /** State with the fixed probability 0.5 (used for the signs of AC). */
+    inline static constexpr Byte FixedState = 113;
+
+    int decode(Byte & state);
+
+    /** Decodes the bits of the magnitude below its leading bit. */
+    int decode_magnitude(int magnitude, Byte * statistics);
+
+    std::function<Byte()> m_next_byte;
+
+    std::uint32_t m_c = 0;
+    std::uint32_t m_a = 0;
+    int m_ct = 0;
+
+    std::array<std::array<Byte, DCStatisticsSize>, TablesCount> m_dc_statistics{};
+    std::array<std::array<Byte, ACStatisticsSize>, TablesCount> m_ac_statistics{};
+    Byte m_fixed_state = FixedState;
+
+    std::array<Byte, TablesCount> m_dc_lower{0, 0, 0, 0};
+    std::array<Byte, TablesCount> m_dc_upper{1, 1, 1, 1};
+    std::array<Byte, TablesCount> m_ac_threshold{5, 5, 5, 5};
+
+    std::vector<std::size_t> m_dc_contexts;
+};
@@ -1,10 +1,17 @@
 #pragma once
 
+#include "decoder/arithmetic_scan_decoder.hpp"
+#include "decoder/lossless_transform.hpp"
+#include "decoder/scan_index.hpp"
+#include "utils/arena.hpp"
+#include "utils/arithmetic_code.hpp"
 #include "utils/huffman_code.hpp"
 #include "utils/image.hpp"
 #include "utils/quantization_table.hpp"
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 
 /**
@@ -28,16 +35,133 @@ struct Decoder
 
         /** Decode the residuals of the DCT coefficients in their places. */
         DECODE_RESIDUALS,
+
+        /**
+         * Zero out DCT coefficients, enhance the decoded image and encode the
+         * residuals of the retained coefficients in one pass over the bitstream.
+         */
+        TRANSCODE,
+
+        /**
+         * Zero out DCT coefficients, enhance the decoded image and decode the
+         * residuals of the retained coefficients in one pass over the bitstream.
+         */
+        TRANSDECODE,
+
+        /**
+         * Transform the image losslessly or requantize it in the DCT domain
+         * and write it without decoding the pixels.
+         */
+        TRANSFORM,
     };
 
+    /**
+     * @brief Quality enhancement of the image with zeroed out DCT coefficients
+     * used in TRANSCODE and TRANSDECODE modes.
+     */
+    using Enhancer = std::function<utils::Image(const utils::Image &)>;
+
     Decoder() = default;
 
     Decoder & set_dct_filter(const std::size_t dct_filter_power);
 
+    /**
+     * @brief Chooses the number of zeroed out coefficients of every luma block
+     * by its class (see utils::BlockClass) around the power of the filter.
+     * No side information is written, the transdecoding requires the same
+     * setting.
+     */
+    Decoder & set_adaptive_dct_filter(const bool is_adaptive);
+
+    /**
+     * @brief Writes the residuals with the context-adaptive arithmetic coder
+     * instead of the Huffman code of the image (ENCODE_RESIDUALS and TRANSCODE
+     * modes). The arithmetic coded residuals are recognized by the decoder
+     * by APP10 segment.
+     */
+    Decoder & set_arithmetic_residuals(const bool is_arithmetic);
+
     Decoder & toggle_mode(const Mode & mode);
 
     Decoder & set_enhanced_file(const std::string & enhanced_file_name);
 
+    Decoder & set_enhanced_image(utils::Image enhanced_image);
+
+    Decoder & set_enhancer(Enhancer enhancer);
+
+    /** Sets the operation and the crop region of TRANSFORM mode. */
+    Decoder & set_lossless_transform(LosslessTransform transform);
+
+    /**
+     * @brief Requantizes the coefficients in TRANSFORM mode to the tables of
+     * the encoder of the given quality (1-100). A step never gets finer than
+     * the original one.
+     */
+    Decoder & set_requantization_quality(const std::size_t quality);
+
+    /**
+     * @brief Converts 4:4:4 image to 4:2:0 in TRANSFORM mode: every 2x2 chroma
+     * blocks are merged into one in the DCT domain.
+     */
+    Decoder & set_chroma_subsampling(const bool is_subsampling);
+
+    /**
+     * @brief Builds the scan seek index while decoding.
+     *
+     * @param rows_per_entry Number of MCU rows between the index entries.
+     * @return The decoder itself.
+     */
+    Decoder & set_scan_index_interval(const std::size_t rows_per_entry);
+
+    /**
+     * @brief Sets the scan seek index built earlier for the same image. The
+     * index may also be read from APP9 segment of the image.
+     */
+    Decoder & set_scan_index(ScanIndex scan_index);
+
+    /**
+     * @brief Sets the number of threads decoding the bands of the indexed scan,
+     * 0 means the number of CPU cores.
+     */
+    Decoder & set_threads_count(const std::size_t threads_count);
+
+    /**
+     * @brief Decodes only the given rows of the image. Without the scan index
+     * the decoding stops after the region, with the index only the bands
+     * covering the region are decoded.
+     *
+     * @param first_row The first row of the region.
+     * @param rows_count Height of the region.
+     * @return The decoder itself.
+     */
+    Decoder & set_region(const std::size_t first_row, const std::size_t rows_count);
+
+    /**
+     * @brief Keeps the decoded components at their own sampling: the chroma
+     * is not upsampled and the image is not converted to RGB, the planes
+     * are available by get_component(). The transcoding modes still convert
+     * the image for the enhancer.
+     */
+    Decoder & set_planar_output(const bool is_planar);
+
+    /**
+     * @brief Decodes only the luma: the chroma blocks are entropy decoded just
+     * to keep the bitstream in sync, they are neither dequantized nor
+     * transformed and have no planes. The image is the grayscale Y plane.
+     * Supported when decoding pixels.
+     */
+    Decoder & set_luma_only(const bool is_luma_only);
+
+    /**
+     * @brief On corrupt entropy-coded data or a wrong RST marker skips the data
+     * up to the next RST or EOI marker instead of throwing. The lost MCUs and
+     * the already decoded ones of the damaged restart interval are filled with
+     * the last DC of every component and reported by get_damaged_ranges().
+     * Supported when decoding pixels of Huffman coded images without the scan
+     * index.
+     */
+    Decoder & set_error_resilience(const bool is_resilient);
+
     struct HuffmanCodeEntry
     {
         unsigned char m_length = 0;
@@ -52,12 +176,36 @@ struct Decoder
         Sampling & set_greater(const Sampling & other);
     };
 
+    /**
+     * @brief Sizes of the luma blocks of one class in the input bitstream
+     * and in the output one (residual and transcoding modes).
+     */
+    struct BlockClassStatistics
+    {
+        std::size_t m_blocks_count = 0;
+        std::size_t m_input_bits = 0;
+        std::size_t m_output_bits = 0;
+    };
+
+    struct Region
+    {
+        std::size_t m_first_row;
+        std::size_t m_rows_count;
+    };
+
     struct Shape
     {
         std::size_t m_width;
         std::size_t m_height;
     };
 
+    /** MCUs lost in the error resilient mode, numbered in the scan order. */
+    struct DamagedRange
+    {
+        std::size_t m_first_mcu;
+        std::size_t m_mcus_count;
+    };
+
     struct Component
     {
         std::size_t m_id = 0;
@@ -71,7 +219,8 @@ struct Decoder
 
         int m_last_dc = 0;
         utils::HuffmanCode m_huffman_code;
-        BytesList m_pixels{};
+        utils::ArithmeticCode m_arithmetic_code;
+        utils::Plane m_pixels{};
 
         Component & set_id(const std::size_t id);
 
@@ -101,20 +250,56 @@ struct Decoder
     HuffmanCodeEntry m_huffman_tables[4][65536];
     std::size_t m_buffer = 0;
     std::size_t m_bits_in_buffer = 0;
+    /** The end of the first RST marker read into the bit buffer, but not checked yet. */
+    const unsigned char * m_buffered_restart_marker = nullptr;
+    /** More RST markers were read after it, i.e. the damaged data ran over the marker. */
+    bool m_is_restart_marker_overrun = false;
     int m_rst_interval = 0;
-    BytesList m_rgb{};
+    /** Holds the planes of the image, recycled by reset(). */
+    utils::Arena m_arena;
+    utils::Plane m_rgb{};
     std::vector<std::vector<int>> m_dct_coefficients_distribution{64};
 
     std::size_t m_dct_filter_power = 0;
+    bool m_is_adaptive_dct_filter = false;
+    bool m_is_arithmetic_output = false;
+    bool m_is_arithmetic_input = false;
+    std::optional<utils::ArithmeticEncoder> m_arithmetic_encoder;
+    std::optional<utils::ArithmeticDecoder> m_arithmetic_decoder;
+    /** The frame is coded with the arithmetic coder of JPEG (SOF9). */
+    bool m_is_arithmetic_frame = false;
+    /** Pairs of Tc/Tb and Cs values of DAC segments. */
+    std::vector<std::pair<Byte, Byte>> m_arithmetic_conditioning;
+    std::optional<ArithmeticScanDecoder> m_arithmetic_scan_decoder;
+    bool m_is_output_suppressed = false;
+    std::array<BlockClassStatistics, utils::BlockClassesCount> m_block_class_statistics{};
     std::array<utils::HuffmanCode::HuffmanTable, 4> m_huffman_encoding_tables;
     bool m_is_scanning = false;
     std::optional<utils::Image> m_enhanced_file;
+    Enhancer m_enhancer;
+    /** Entropy-decoded blocks in scan order (zigzag order, absolute DC) kept for the residuals pass. */
+    std::vector<std::array<int, 64>> m_retained_blocks;
     Output m_output{};
     std::map<int, std::size_t> m_corrections_statistic;
     std::size_t m_new_zeros_count = 0;
     std::size_t m_corrupted_zeros_count = 0;
     std::vector<int> m_residuals;
 
+    const unsigned char * m_scan_start = nullptr;
+    std::size_t m_scan_size = 0;
+    std::size_t m_scan_index_interval = 0;
+    std::optional<ScanIndex> m_scan_index;
+    std::size_t m_threads_count = 0;
+    std::optional<Region> m_region;
+    std::size_t m_region_offset = 0;
+    bool m_is_planar_output = false;
+    bool m_is_luma_only = false;
+    LosslessTransform m_lossless_transform{};
+    std::optional<std::size_t> m_requantization_quality;
+    bool m_is_chroma_subsampling = false;
+    bool m_is_error_resilient = false;
+    std::vector<DamagedRange> m_damaged_ranges;
+
     static unsigned char clip(const int x);
 
     // Mode checks
@@ -123,6 +308,13 @@ struct Decoder
     bool IsEncodeResidualsMode() const;
     bool IsDecodeResidualsMode() const;
     bool IsResidualsProcessing() const;
+    bool IsTranscodeMode() const;
+    bool IsTransdecodeMode() const;
+    bool IsTranscoding() const;
+    bool IsTransformMode() const;
+    bool IsZeroingOut() const;
+    bool IsWritingOutput() const;
+    bool IsWritingArithmeticResiduals() const;
 
     unsigned char get_bytes(const std::size_t count = 1);
 
@@ -142,6 +334,13 @@ struct Decoder
 
     void skip_marker();
 
+    /**
+     * @brief Skips the marker code and returns it. The markers of arithmetic
+     * coded frame are rewritten in the output: SOF9 becomes SOF0 and
+     * the standard Huffman tables are written before SOS.
+     */
+    Byte read_marker();
+
     static bool is_point_of_two(const std::size_t x);
 
     void decode_start_of_frame();
@@ -156,6 +355,10 @@ struct Decoder
 
     void decode_dri(void);
 
+    void decode_arithmetic_conditioning();
+
+    void write_standard_huffman_tables();
+
     struct HuffmanDecodingResult
     {
         int m_run = 0;
@@ -167,31 +370,182 @@ struct Decoder
 
     void decode_block(Component & component, unsigned char * output, utils::DCTCoefficientsFilter & filter, const std::optional<std::array<int, 64>> optional_enhanced_block);
 
+    std::array<int, 64> decode_coefficients(Component & component, const utils::ArithmeticCode::MaskProvider & mask_provider);
+
+    /** Reads the block without computing its coefficients, the luma-only mode. */
+    void skip_block(Component & component);
+
+    void encode_residuals(Component & component,
+                          std::array<int, 64> & block,
+                          const utils::MaskEntry & mask,
+                          const std::optional<std::array<int, 64>> & optional_enhanced_block,
+                          const int last_dc);
+
+    void decode_pixels(const Component & component, const std::array<int, 64> & block, const utils::MaskEntry & mask, unsigned char * output);
+
     static std::size_t get_blocks_count(const std::size_t size, std::size_t sampling);
 
     std::optional<std::array<int, 64>> get_enhanced_coefficients(const Component & component, const std::size_t x, const std::size_t y);
 
     void decode_start_of_scan(void);
 
+    std::size_t get_scan_bits_position() const;
+
+    void write_arithmetic_segment();
+
+    bool decode_arithmetic_segment();
+
+    Byte read_arithmetic_byte();
+
+    void read_arithmetic_restart(const int next_rst);
+
+    void write_block(Component & component, const std::array<int, 64> & block, const int last_dc, const utils::MaskEntry & mask);
+
+    void write_restart_marker(const int rst_number);
+
+    void write_end_of_image();
+
+    void decode_scan_index_segment();
+
+    std::vector<unsigned char *> get_planes();
+
+    std::size_t get_luma_blocks_per_row() const;
+
+    std::pair<std::size_t, std::size_t> get_rows_to_decode() const;
+
+    void decode_mcu_rows(const std::size_t first_row,
+                         const std::size_t last_row,
+                         utils::DCTCoefficientsFilter & filter,
+                         int & rst_count,
+                         int & next_rst,
+                         const std::vector<unsigned char *> & planes);
+
+    enum class RestartMarker
+    {
+        FOUND,
+        /** The expected marker is found, but the data of the interval ran over another one before it. */
+        OVERRUN,
+        /** The data of the interval does not end at the expected marker. */
+        MISSING,
+    };
+
+    /**
+     * @brief Reads the RST marker expected at the end of the restart interval.
+     * Outside the error resilient mode any other marker is an error.
+     */
+    RestartMarker read_restart_marker(const int next_rst);
+
+    /**
+     * @brief Skips the damaged data up to the EOI marker or the next RST marker
+     * expected after the interval or one of the two next intervals in the error
+     * resilient mode.
+     *
+     * @param rst_count The MCUs left in the restart interval, including
+     * the first lost one.
+     * @param next_rst The number of the RST marker expected after the interval.
+     * @param mcus_left The MCUs left to decode, including the first lost one.
+     * @return The number of the lost MCUs.
+     */
+    std::size_t resynchronize(const int rst_count, const int next_rst, const std::size_t mcus_left);
+
+    /** Fills the blocks of the lost MCU with the given DC coefficients of the components. */
+    void fill_damaged_mcu(const std::size_t global_block_x,
+                          const std::size_t global_block_y,
+                          const std::vector<int> & dc_values,
+                          const std::vector<unsigned char *> & planes);
+
+    void add_damaged_range(const std::size_t first_mcu, const std::size_t mcus_count);
+
+    void record_scan_index_entry(const std::size_t mcu_row, const int rst_count, const int next_rst);
+
+    bool can_use_scan_index() const;
+
+    void decode_indexed_rows(const std::size_t first_row, const std::size_t last_row);
+
+    std::unique_ptr<Decoder> make_band_decoder();
+
+    void decode_band(const ScanIndex::Entry & entry, const std::size_t last_row, const std::vector<unsigned char *> & planes);
+
+    void crop_to_region();
+
+    void finish_region();
+
+    /** Crops the region of the planes at their own sampling. */
+    void finish_planar_region();
+
+    void verify_enhanced_image() const;
+
+    utils::Image get_decoded_image() const;
+
+    void encode_retained_residuals();
+
+    /**
+     * @brief Writes the image transformed from the retained blocks with
+     * the original quantization tables and the standard Huffman tables.
+     */
+    void write_transformed_image();
+
+    /**
+     * @brief Replaces the quantization tables by the ones of the requantization
+     * quality.
+     *
+     * @return The original tables in zigzag order by their ids.
+     */
+    std::map<std::size_t, Bytes<64>> requantize_tables();
+
+    /**
+     * @brief Subsamples the chroma of 4:4:4 image by two in both directions,
+     * the luma grid is padded to the whole MCUs by its edge blocks.
+     */
+    void subsample_chroma(std::vector<LosslessTransform::Blocks> & blocks);
+
     void horizontal_upsample(Component & component);
 
     void vertical_upsample(Component & c);
 
     void convert();
 
+    /**
+     * @brief Resets the decoder to its initial state for the next image.
+     * The memory of the image buffers is kept, so the decoding of the images
+     * no larger than the previous ones does not allocate it again.
+     */
     void reset();
 
     void decode(const BytesList & jpeg);
 
+    void decode(const unsigned char * jpeg, const std::size_t size);
+
     std::size_t get_width() const;
 
     std::size_t get_height() const;
 
     bool is_color_image() const;
 
-    const BytesList & get_image() const;
+    /**
+     * @brief Returns the decoded component: the plane of m_width x m_height
+     * samples, whose rows are m_stride bytes apart.
+     */
+    const Component & get_component(const std::size_t index) const;
+
+    /** Returns the sampling factors of the frame, the largest ones of the components. */
+    const Sampling & get_sampling() const;
+
+    const utils::Plane & get_image() const;
 
     std::size_t get_image_size() const;
 
     const Output & get_output() const;
+
+    /** Returns the number of memory chunks requested for the image buffers. */
+    std::size_t get_allocations_count() const;
+
+    const std::optional<ScanIndex> & get_scan_index() const;
+
+    /** Returns the MCUs lost in the error resilient mode. */
+    const std::vector<DamagedRange> & get_damaged_ranges() const;
+
+    utils::DCTCoefficientsFilter get_dct_filter() const;
+
+    const std::array<BlockClassStatistics, utils::BlockClassesCount> & get_block_class_statistics() const;
 };
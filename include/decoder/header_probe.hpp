@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <map>
+#include <vector>
+
+/**
+ * @brief Parameters of JPEG read from the segments before the first scan.
+ *
+ * Unlike the decoder the probe reads only the markers up to SOS and skips
+ * the Huffman tables without building the lookup tables, so it is cheap
+ * enough to catalog large collections of images. Any SOF is accepted,
+ * including the progressive and the lossless ones the decoder does not
+ * support.
+ */
+struct HeaderProbe
+{
+    struct Component
+    {
+        std::size_t m_id = 0;
+        /** Horizontal and vertical sampling factors as written in SOF. */
+        std::size_t m_horizontal_sampling = 1;
+        std::size_t m_vertical_sampling = 1;
+        std::size_t m_quantization_table_id = 0;
+    };
+
+    std::size_t m_width = 0;
+    /** Zero if the height is defined by DNL after the first scan. */
+    std::size_t m_height = 0;
+    std::size_t m_precision = 8;
+    std::vector<Component> m_components{};
+
+    /** Quantization tables in zigzag order by their ids. */
+    std::map<std::size_t, std::array<int, 64>> m_quantization_tables{};
+
+    std::size_t m_restart_interval = 0;
+
+    /** SOF marker of the frame, e.g. 0xC0 for baseline. */
+    unsigned char m_frame_marker = 0;
+
+    bool is_progressive() const;
+
+    bool is_arithmetic() const;
+
+    /**
+     * @brief Estimates the quality (1-100) the luma table was produced with by
+     * the encoder, i.e. by scaling of the standard luminance table.
+     *
+     * @return 0 if the luma table is not defined.
+     */
+    std::size_t estimate_quality() const;
+
+    /**
+     * @brief Parses the markers of JPEG up to the first SOS.
+     *
+     * @throws DecodingException if the data is not JPEG, is truncated or has
+     * no SOF before the scan.
+     */
+    static HeaderProbe probe(const unsigned char * data, std::size_t size);
+};
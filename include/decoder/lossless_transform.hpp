@@ -0,0 +1,101 @@
+#pragma once
+
+#include "utils/bytes.hpp"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Lossless transformation of JPEG in the DCT domain: the blocks are
+ * reordered and their coefficients are transposed or negated, so the image
+ * is neither decoded nor quantized again.
+ *
+ * As in jpegtran -trim, the partial MCUs which would move to the left or
+ * to the top edge of the image are dropped, and the crop region is extended
+ * to the left and to the top up to the MCU boundary.
+ */
+struct LosslessTransform
+{
+    enum class Operation
+    {
+        NONE,
+        FLIP_HORIZONTAL,
+        FLIP_VERTICAL,
+        /** Mirrors the image by the main diagonal. */
+        TRANSPOSE,
+        /** Mirrors the image by the secondary diagonal. */
+        TRANSVERSE,
+        /** Clockwise rotations. */
+        ROTATE_90,
+        ROTATE_180,
+        ROTATE_270,
+    };
+
+    /** Region of the transformed image in pixels. */
+    struct Crop
+    {
+        std::size_t m_x = 0;
+        std::size_t m_y = 0;
+        std::size_t m_width = 0;
+        std::size_t m_height = 0;
+    };
+
+    /** Blocks of one component row by row, the coefficients in natural order. */
+    struct Blocks
+    {
+        std::size_t m_width = 0;
+        std::size_t m_height = 0;
+        std::vector<std::array<int, 64>> m_blocks{};
+
+        std::array<int, 64> & at(const std::size_t x, const std::size_t y) { return m_blocks[y * m_width + x]; }
+        const std::array<int, 64> & at(const std::size_t x, const std::size_t y) const { return m_blocks[y * m_width + x]; }
+    };
+
+    Operation m_operation = Operation::NONE;
+    std::optional<Crop> m_crop{};
+
+    /** The operation swaps the width and the height of the image. */
+    bool is_transposing() const;
+
+    /** The columns of the source image are mirrored, the partial MCU column is dropped. */
+    bool is_mirroring_columns() const;
+
+    /** The rows of the source image are mirrored, the partial MCU row is dropped. */
+    bool is_mirroring_rows() const;
+
+    /** Transforms the coefficients of the block in natural order. */
+    void transform_block(std::array<int, 64> & block) const;
+
+    /** Transforms the quantization table in zigzag order, as written in DQT. */
+    Bytes<64> transform_quantization_table(const Bytes<64> & table) const;
+
+    /**
+     * @brief Transforms the blocks of the component.
+     *
+     * @param blocks The blocks of the source image.
+     * @param width The number of the block columns kept.
+     * @param height The number of the block rows kept.
+     * @return The blocks of the transformed image.
+     */
+    Blocks transform(const Blocks & blocks, const std::size_t width, const std::size_t height) const;
+
+    /** Returns the rectangle of the blocks starting at the given one. */
+    static Blocks crop(const Blocks & blocks, const std::size_t x, const std::size_t y, const std::size_t width, const std::size_t height);
+
+    /**
+     * @brief Parses the name of the operation: flip-horizontal, flip-vertical,
+     * transpose, transverse, rotate-90, rotate-180 or rotate-270.
+     *
+     * @throws std::invalid_argument for the unknown name.
+     */
+    static Operation parse_operation(const std::string & name);
+
+    /**
+     * @brief Parses the crop region in the form WxH+X+Y or WxH.
+     *
+     * @throws std::invalid_argument for the invalid region.
+     */
+    static Crop parse_crop(const std::string & geometry);
+};
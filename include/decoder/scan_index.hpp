@@ -0,0 +1,78 @@
+#pragma once
+
+#include "utils/bytes.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Seek index of the scan: the state of the decoder at the beginning of
+ * every N-th row of MCUs.
+ *
+ * The index allows to start decoding the scan from the indexed row, so
+ * the bands of rows are decoded in parallel, or only the bands covering
+ * the requested region are decoded. The offsets are counted from the start of
+ * the scan data, so the index stays valid when segments are added before the
+ * scan (e.g. the index itself as APP9 segment).
+ */
+struct ScanIndex
+{
+    /**
+     * @brief State of the decoder at the beginning of the row of MCUs.
+     */
+    struct Entry
+    {
+        std::size_t m_mcu_row = 0;
+
+        /** Offset of the next unread byte from the start of the scan data. */
+        std::size_t m_offset = 0;
+
+        /** Bits already read from the bitstream, but not decoded yet. */
+        std::size_t m_bits_count = 0;
+        std::size_t m_bits = 0;
+
+        /** Number of MCUs before the next RST marker and its number. */
+        int m_rst_count = 0;
+        int m_next_rst = 0;
+
+        /** DC predictors of the components. */
+        std::vector<int> m_dc_predictors{};
+    };
+
+    /** Number of MCU rows between the entries. */
+    std::size_t m_rows_per_entry = 0;
+
+    /** Size of the data from the start of the scan to the end of the file. */
+    std::size_t m_scan_size = 0;
+
+    std::vector<Entry> m_entries{};
+
+    /** APP9 marker of the segment with the index. */
+    inline static constexpr Byte SegmentMarker = 0xE9;
+
+    /**
+     * @brief Serializes the index (the same format is used in the sidecar file
+     * and in the APP9 segment).
+     */
+    BytesList to_bytes() const;
+
+    static ScanIndex from_bytes(const unsigned char * data, std::size_t size);
+
+    /**
+     * @brief Checks if the bytes are a serialized index (e.g. the payload of
+     * APP9 segment belongs to the index).
+     */
+    static bool is_scan_index(const unsigned char * data, std::size_t size);
+
+    void to_file(const std::string & file_name) const;
+
+    static ScanIndex from_file(const std::string & file_name);
+
+    /**
+     * @brief Inserts the index into JPEG as APP9 segment right after SOI marker.
+     *
+     * @param jpeg The bitstream the index was built for.
+     * @return The bitstream with the index.
+     */
+    BytesList embed(const BytesList & jpeg) const;
+};
@@ -4,16 +4,113 @@
  */
 #pragma once
 
+#include "utils/output.hpp"
+
+#include <optional>
+#include <ostream>
 #include <string>
+#include <vector>
 
 namespace utils {
 
 class Image;
+class ImageReader;
+
+} // namespace utils
+
+namespace implementation {
+
+class Encoder;
 
 }
 
 class Encoder
 {
 public:
+    /**
+     * @brief Settings of the encoding.
+     */
+    struct Options
+    {
+        int m_quality = 90;
+
+        /**
+         * Chroma subsampling 4:2:0 of color images, by default it is used
+         * for the quality up to 90.
+         */
+        std::optional<bool> m_subsample = std::nullopt;
+
+        /** Number of MCUs between RST markers, 0 means no markers. */
+        std::size_t m_restart_interval = 0;
+
+        /**
+         * Maximum size of the file in bytes, the best quality fitting it is
+         * used instead of m_quality. 0 means no limit.
+         */
+        std::size_t m_target_size = 0;
+    };
+
+    /** Source PPM file and resulting JPEG file of an image of the batch. */
+    struct Task
+    {
+        std::string m_input_file_name;
+        std::string m_output_file_name;
+    };
+
     static bool encode(const std::string & file_name, const utils::Image & image, int quality);
+
+    static bool encode(const std::string & file_name, const utils::Image & image, const Options & options);
+
+    /**
+     * @brief Encodes the image with the best quality keeping the file within
+     * the target size. The colors are converted and the blocks are transformed
+     * only once, each tried quality just requantizes them and counts the
+     * bytes, and the file is written once with the found quality.
+     *
+     * @return The quality of the file or std::nullopt if even the quality 1
+     * does not fit, then no file is written.
+     */
+    static std::optional<int> encode_to_size(const std::string & file_name, const utils::Image & image, const Options & options);
+
+    /**
+     * @brief Encodes the image band by band, writing the completed bytes to
+     * the stream as soon as each band is encoded.
+     *
+     * @param reader The source of the image rows.
+     * @param stream The stream for the JPEG bitstream.
+     * @param quality Encoding quality.
+     */
+    static bool encode(utils::ImageReader & reader, std::ostream & stream, int quality);
+
+    /**
+     * @throws std::invalid_argument if the target size is set, it needs the
+     * whole image.
+     */
+    static bool encode(utils::ImageReader & reader, std::ostream & stream, const Options & options);
+
+    /**
+     * @brief Encodes the batch of images in four stages running in their own
+     * threads: reading, conversion of the colors with the forward DCT,
+     * quantization with the entropy coding, and writing. While an image is
+     * entropy-coded the next ones are read and transformed and the previous
+     * ones are written, so the throughput approaches the slowest stage.
+     *
+     * If an image cannot be read, the images before it are still encoded and
+     * written, the rest are skipped and the error naming the file is thrown.
+     * Any other error stops all the stages at once.
+     *
+     * @param queue_capacity The number of the images waiting between two
+     * stages, at most 4 + 3 * queue_capacity images are kept in memory.
+     * @throws std::invalid_argument if the target size is set or the
+     * capacity is 0.
+     * @throws std::runtime_error if an image cannot be read or written.
+     */
+    static void encode(const std::vector<Task> & tasks, const Options & options, std::size_t queue_capacity = 2);
+
+private:
+    static void write_headers(Output & output, const implementation::Encoder & encoder, std::size_t width, std::size_t height);
+
+    static void write_grayscale_headers(Output & output, const implementation::Encoder & encoder, std::size_t width, std::size_t height);
+
+    static void write_restart_interval(Output & output, const implementation::Encoder & encoder);
 };
@@ -19,6 +19,12 @@ public:
 
     void encode(std::array<float, 64> & block);
 
+    /** Encodes the block already transformed by the forward DCT. */
+    void encode_coefficients(const std::array<float, 64> & coefficients);
+
+    /** Resets the DC prediction after RST marker. */
+    void reset();
+
 private:
     int m_last_dc;
     const utils::QuantizationTable & m_quantization_table;
@@ -8,6 +8,10 @@
 #include "utils/output.hpp"
 #include "utils/quantization_table.hpp"
 
+#include <array>
+#include <optional>
+#include <vector>
+
 namespace utils {
 
 class Image;
@@ -19,17 +23,61 @@ namespace implementation {
 class Encoder
 {
 public:
-    Encoder(const std::size_t quality, Output & output);
+    /**
+     * Blocks of the image transformed by the forward DCT in the order of
+     * encoding, they depend only on the subsampling and not on the quality.
+     */
+    using Coefficients = std::vector<std::array<float, 64>>;
+
+    /**
+     * @param subsample Chroma subsampling 4:2:0, by default it is used for
+     * the quality up to 90.
+     * @param restart_interval Number of MCUs between RST markers, 0 means
+     * no markers.
+     */
+    Encoder(const std::size_t quality,
+            const std::size_t components_count,
+            const std::optional<bool> subsample,
+            const std::size_t restart_interval,
+            Output & output);
 
     void encode(const utils::Image & image);
 
+    /** Converts the colors of the image and transforms its blocks without encoding them. */
+    Coefficients transform(const utils::Image & image) const;
+
+    /**
+     * @brief Quantizes and encodes the blocks of the image transformed by the
+     * encoder with the same subsampling.
+     */
+    void encode(const Coefficients & coefficients);
+
+    /**
+     * @brief Returns the number of image rows covered by one row of MCUs.
+     */
+    std::size_t get_mcu_height() const;
+
 private:
     template <std::size_t Scaling>
     void encode(const utils::Image & image);
 
+    void encode_grayscale(const utils::Image & image);
+
+    template <std::size_t Scaling>
+    void transform(const utils::Image & image, Coefficients & coefficients) const;
+
+    void transform_grayscale(const utils::Image & image, Coefficients & coefficients) const;
+
+    static void read_grayscale_block(const utils::Image & image, std::size_t x, std::size_t y, std::array<float, 64> & block);
+
+    /** Writes RST marker before the MCU when the restart interval ends. */
+    void start_mcu();
+
 public:
+    const bool m_grayscale;
     const bool m_subsample;
     const std::size_t m_quality;
+    const std::size_t m_restart_interval;
 
     const utils::QuantizationTable m_luminance_quantization_table;
     const utils::QuantizationTable m_chrominance_quantization_table;
@@ -37,6 +85,10 @@ public:
     implementation::BlockEncoder m_luminance_encoder;
     implementation::BlockEncoder m_chrominance_blue_encoder;
     implementation::BlockEncoder m_chrominance_red_encoder;
+
+private:
+    Output & m_output;
+    std::size_t m_mcus_count = 0;
 };
 
 } // namespace implementation
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @file transcoder.h
+ * @brief C interface of the JPEG transcoder working from memory to memory.
+ *
+ * All functions are reentrant: they do not use any global state, never throw
+ * and write the results into the buffers provided by the caller. When the
+ * buffer is too small TRANSCODER_BUFFER_TOO_SMALL is returned and the required
+ * size is written to the corresponding output parameter.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Status codes returned by the functions of the transcoder.
+ */
+enum transcoder_status
+{
+    TRANSCODER_OK = 0,
+
+    /** Not a JPEG file. */
+    TRANSCODER_NO_JPEG = 1,
+
+    /** Unsupported format. */
+    TRANSCODER_UNSUPPORTED = 2,
+
+    /** Syntax error in JPEG file. */
+    TRANSCODER_SYNTAX_ERROR = 3,
+
+    /** Internal application error. */
+    TRANSCODER_INTERNAL_ERROR = 4,
+
+    /** Invalid arguments (null pointers, mismatching dimensions). */
+    TRANSCODER_INVALID_ARGUMENT = 5,
+
+    /** The output buffer is too small. */
+    TRANSCODER_BUFFER_TOO_SMALL = 6,
+
+    /** Memory allocation failed. */
+    TRANSCODER_OUT_OF_MEMORY = 7,
+};
+
+/**
+ * @brief Dimensions of the decoded image. The pixels are stored row by row,
+ * components of each pixel are interleaved (RGB or grayscale).
+ */
+struct transcoder_image_info
+{
+    size_t width;
+    size_t height;
+    size_t components_count;
+};
+
+/**
+ * @brief Returns the name of the status code.
+ */
+const char * transcoder_status_name(int status);
+
+/**
+ * @brief Reads the image dimensions from the frame header without decoding,
+ * the baseline (SOF0) and the arithmetic coded (SOF9) frames are supported.
+ *
+ * @param jpeg JPEG bitstream.
+ * @param jpeg_size Size of the bitstream.
+ * @param info Dimensions of the image.
+ * @return Status code.
+ */
+int transcoder_read_info(const unsigned char * jpeg, size_t jpeg_size, struct transcoder_image_info * info);
+
+/**
+ * @brief Decodes JPEG into the pixels buffer.
+ *
+ * @param jpeg JPEG bitstream.
+ * @param jpeg_size Size of the bitstream.
+ * @param pixels Buffer for the pixels of size width * height * components_count.
+ * @param pixels_capacity Size of the pixels buffer.
+ * @param info Dimensions of the decoded image (may be null).
+ * @return Status code.
+ */
+int transcoder_decode(const unsigned char * jpeg,
+                      size_t jpeg_size,
+                      unsigned char * pixels,
+                      size_t pixels_capacity,
+                      struct transcoder_image_info * info);
+
+/**
+ * @brief Decodes JPEG zeroing out the DCT coefficients of luma by masks of
+ * DCTCoefficientsFilter.
+ *
+ * @param power Number of zeroed out coefficients of each block.
+ * @see transcoder_decode
+ */
+int transcoder_zero_out_and_decode(const unsigned char * jpeg,
+                                   size_t jpeg_size,
+                                   size_t power,
+                                   unsigned char * pixels,
+                                   size_t pixels_capacity,
+                                   struct transcoder_image_info * info);
+
+/**
+ * @brief Replaces the zeroed out DCT coefficients with the residuals between
+ * the original coefficients and the coefficients of the enhanced image.
+ *
+ * @param jpeg Original JPEG bitstream.
+ * @param jpeg_size Size of the bitstream.
+ * @param power Number of zeroed out coefficients of each block.
+ * @param enhanced Pixels of the enhanced image.
+ * @param enhanced_info Dimensions of the enhanced image, must match the JPEG.
+ * @param output Buffer for the transcoded JPEG.
+ * @param output_capacity Size of the output buffer.
+ * @param output_size Size of the transcoded JPEG (or the required size).
+ * @return Status code.
+ */
+int transcoder_encode_residuals(const unsigned char * jpeg,
+                                size_t jpeg_size,
+                                size_t power,
+                                const unsigned char * enhanced,
+                                const struct transcoder_image_info * enhanced_info,
+                                unsigned char * output,
+                                size_t output_capacity,
+                                size_t * output_size);
+
+/**
+ * @brief Restores the original JPEG from the transcoded one.
+ *
+ * @see transcoder_encode_residuals
+ */
+int transcoder_decode_residuals(const unsigned char * jpeg,
+                                size_t jpeg_size,
+                                size_t power,
+                                const unsigned char * enhanced,
+                                const struct transcoder_image_info * enhanced_info,
+                                unsigned char * output,
+                                size_t output_capacity,
+                                size_t * output_size);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "utils/bytes.hpp"
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace utils {
+
+/**
+ * @brief Bump allocator for the buffers of one image. Every allocation is
+ * aligned to the cache line, deallocation does nothing: the memory is
+ * recycled all at once by release().
+ */
+class Arena : public std::pmr::memory_resource
+{
+public:
+    inline static constexpr std::size_t Alignment = 64;
+
+    Arena() = default;
+    Arena(Arena && other) noexcept;
+    Arena & operator=(Arena && other) noexcept;
+    ~Arena() override;
+
+    /**
+     * @brief Makes all the memory available again. The chunks are merged
+     * into one, so the next image of the same size is decoded without
+     * requesting memory from the system.
+     */
+    void release();
+
+    /** Returns the number of chunks requested from the system so far. */
+    std::size_t get_allocations_count() const;
+
+    /** Returns the number of bytes allocated since the last release. */
+    std::size_t get_used_size() const;
+
+private:
+    inline static constexpr std::size_t MinChunkSize = 1 << 16;
+
+    struct Chunk
+    {
+        Byte * m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+
+    void * do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+    void do_deallocate(void * pointer, std::size_t bytes, std::size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override;
+
+    void add_chunk(std::size_t size);
+
+    void free_chunks();
+
+    std::vector<Chunk> m_chunks;
+    /** Bytes used in the last chunk. */
+    std::size_t m_chunk_used_size = 0;
+    std::size_t m_used_size = 0;
+    std::size_t m_allocations_count = 0;
+};
+
+/**
+ * @brief Pixels of an image plane placed in the arena. The plane does not
+ * own the memory, it stays valid until the arena is released.
+ */
+class Plane
+{
+public:
+    Plane() = default;
+
+    Plane(std::size_t size, Arena & arena);
+
+    Byte * data() { return m_data; }
+    const Byte * data() const { return m_data; }
+
+    std::size_t size() const { return m_size; }
+
+    Byte * begin() { return m_data; }
+    const Byte * begin() const { return m_data; }
+
+    Byte * end() { return m_data + m_size; }
+    const Byte * end() const { return m_data + m_size; }
+
+    Byte & operator[](const std::size_t i) { return m_data[i]; }
+    const Byte & operator[](const std::size_t i) const { return m_data[i]; }
+
+    /** Drops the first bytes moving the rest to the start of the plane. */
+    void erase_front(std::size_t count);
+
+private:
+    Byte * m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+} // namespace utils
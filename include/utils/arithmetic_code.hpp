@@ -0,0 +1,157 @@
+#pragma once
+
+#include "utils/bytes.hpp"
+#include "utils/dct_coefficients_filter.hpp"
+#include "utils/output.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+namespace utils {
+
+/**
+ * @brief Adaptive probability of zero bit, 12-bit fixed point.
+ */
+class Probability
+{
+public:
+    inline static constexpr std::uint32_t Bits = 12;
+    inline static constexpr std::uint32_t One = 1 << Bits;
+
+    std::uint32_t get() const { return m_value; }
+
+    void update(const bool bit)
+    {
+        if (bit) {
+            m_value -= m_value >> AdaptationShift;
+        }
+        else {
+            m_value += (One - m_value) >> AdaptationShift;
+        }
+    }
+
+private:
+    inline static constexpr std::uint32_t AdaptationShift = 5;
+
+    std::uint16_t m_value = One / 2;
+};
+
+/**
+ * @brief Binary range encoder. The bytes are written to the output with
+ * stuffing of 0xFF bytes, so the markers following the scan stay recognizable.
+ */
+class ArithmeticEncoder
+{
+public:
+    explicit ArithmeticEncoder(Output & output);
+
+    void encode(bool bit, Probability & probability);
+
+    /** Flushes the state of the encoder, the scan may be followed by a marker. */
+    void finish();
+
+private:
+    void shift_low();
+
+    Output * m_output;
+    std::uint64_t m_low = 0;
+    std::uint32_t m_range = 0xFFFFFFFF;
+    Byte m_cache = 0;
+    std::size_t m_cache_size = 1;
+};
+
+/**
+ * @brief Binary range decoder, the counterpart of ArithmeticEncoder.
+ */
+class ArithmeticDecoder
+{
+public:
+    /**
+     * @param next_byte Returns the next byte of the scan with the stuffing
+     * removed, zeros after the end of the scan.
+     */
+    explicit ArithmeticDecoder(std::function<Byte()> next_byte);
+
+    bool decode(Probability & probability);
+
+private:
+    std::function<Byte()> m_next_byte;
+    std::uint32_t m_code = 0;
+    std::uint32_t m_range = 0xFFFFFFFF;
+};
+
+/**
+ * @brief Context model of the blocks of one component coded by
+ * the arithmetic coder instead of HuffmanCode.
+ *
+ * The end of block and zero flags are conditioned on the zigzag position,
+ * on whether the position is zeroed out by the filter and on the previous
+ * block of the component, the magnitudes on the frequency band and the mask.
+ * The first ProtectedCount positions are never zeroed out, so the mask is
+ * requested only when the coding reaches the later ones, and the adaptive
+ * filter can classify the block by its decoded head.
+ */
+class ArithmeticCode
+{
+public:
+    /** APP10 segment marking the residuals coded with the arithmetic coder. */
+    inline static constexpr Byte SegmentMarker = 0xEA;
+    inline static constexpr Bytes<8> Signature = {'R', 'E', 'S', 'I', 'D', 'A', 'C', 1};
+
+    inline static constexpr std::size_t ProtectedCount = 6;
+
+    using MaskProvider = std::function<const Mask &(const std::array<int, 64> &)>;
+
+    /**
+     * @param block The coefficients in zigzag order with the absolute DC.
+     * @param mask Zeroed out positions of the block.
+     */
+    void encode(const std::array<int, 64> & block, int last_dc, const Mask & mask, ArithmeticEncoder & encoder);
+
+    /**
+     * @param mask_provider Called once per block with the coefficients decoded
+     * so far (at least the first ProtectedCount ones), returns the mask.
+     * @return The coefficients in zigzag order with the absolute DC.
+     */
+    std::array<int, 64> decode(int last_dc, const MaskProvider & mask_provider, ArithmeticDecoder & decoder);
+
+private:
+    inline static constexpr std::size_t MagnitudeBits = 16;
+    inline static constexpr std::size_t NeighbourClasses = 3;
+    inline static constexpr std::size_t Bands = 4;
+
+    struct MagnitudeContexts
+    {
+        std::array<Probability, MagnitudeBits> m_exponent{};
+        std::array<std::array<Probability, MagnitudeBits>, MagnitudeBits> m_mantissa{};
+    };
+
+    template <class Coder>
+    int code_value(int value, MagnitudeContexts & magnitude, Probability & zero, Probability & sign, Coder & coder);
+
+    template <class Coder>
+    int code_nonzero(int value, MagnitudeContexts & magnitude, Probability & sign, Coder & coder);
+
+    template <class Coder>
+    void code_block(std::array<int, 64> & block, int last_dc, const MaskProvider & mask_provider, Coder & coder);
+
+    static std::size_t get_band(std::size_t position);
+
+    // DC
+    std::array<Probability, 2> m_dc_zero{};
+    std::array<Probability, 2> m_dc_sign{};
+    std::array<MagnitudeContexts, 2> m_dc_magnitude{};
+    bool m_is_last_dc_difference_zero = true;
+
+    // AC
+    std::array<std::array<std::array<Probability, NeighbourClasses>, 2>, 64> m_end_of_block{};
+    std::array<std::array<std::array<Probability, 2>, 2>, 64> m_zero{};
+    std::array<Probability, 2> m_sign{};
+    std::array<std::array<MagnitudeContexts, 2>, Bands> m_magnitude{};
+
+    /** Coefficients of the previous block of the component. */
+    std::array<int, 64> m_previous_block{};
+};
+
+} // namespace utils
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <vector>
+
+namespace utils {
+
+/**
+ * @brief A three-dimensional tensor stored in height-width-channels order.
+ *
+ * The channels of one pixel are contiguous, which allows to vectorize the
+ * convolution over the output channels.
+ */
+struct Tensor
+{
+    std::size_t m_height = 0;
+    std::size_t m_width = 0;
+    std::size_t m_channels = 0;
+    std::vector<float> m_data{};
+
+    void resize(std::size_t height, std::size_t width, std::size_t channels);
+
+    float * at(std::size_t row, std::size_t column);
+
+    const float * at(std::size_t row, std::size_t column) const;
+};
+
+/**
+ * @brief A convolutional layer preserving the spatial dimensions of the
+ * tensor (zero padding), optionally followed by PReLU activation.
+ */
+class Convolution
+{
+public:
+    /**
+     * @brief Reads the layer from the converted checkpoint.
+     *
+     * The layer is stored as four 32-bit numbers (input channels, output
+     * channels, kernel size and PReLU parameters count) followed by
+     * the weights in PyTorch order, biases and PReLU parameters.
+     *
+     * @param input The stream with converted checkpoint.
+     * @return Loaded layer.
+     */
+    static Convolution from_stream(std::istream & input);
+
+    std::size_t get_input_channels() const;
+
+    std::size_t get_output_channels() const;
+
+    std::size_t get_radius() const;
+
+    /**
+     * @brief Applies the layer to the concatenation of the inputs.
+     *
+     * @param inputs Tensors concatenated along the channels.
+     * @param output The tensor of the same spatial size for the result.
+     */
+    void apply(const std::vector<const Tensor *> & inputs, Tensor & output) const;
+
+private:
+    /** Number of output channels processed at once. */
+    inline static constexpr std::size_t OutputBlock = 16;
+
+    /** Number of pixels of the row processed at once. */
+    inline static constexpr std::size_t PixelsBlock = 8;
+
+    Convolution(std::size_t input_channels,
+                std::size_t output_channels,
+                std::size_t kernel_size,
+                const std::vector<float> & weights,
+                std::vector<float> && biases,
+                std::vector<float> && activation);
+
+    void apply_block(const std::vector<const Tensor *> & inputs,
+                     Tensor & output,
+                     std::size_t row,
+                     std::size_t column,
+                     std::size_t pixels,
+                     std::size_t output_block) const;
+
+    std::size_t m_input_channels;
+    std::size_t m_output_channels;
+    std::size_t m_kernel_size;
+
+    /** Weights in [output block][kernel row][kernel column][input channel][output channel] order. */
+    std::vector<float> m_weights;
+    std::vector<float> m_biases;
+    std::vector<float> m_activation;
+};
+
+} // namespace utils
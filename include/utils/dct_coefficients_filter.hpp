@@ -1,24 +1,98 @@
 #pragma once
 
+#include <array>
 #include <bitset>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace utils {
 
 using Mask = std::bitset<64>;
 inline static constexpr Mask MaskAll = 0xffffffffffffffff;
 
+/**
+ * @brief Mask of the filter together with the zigzag positions it zeroes out,
+ * so the loops over the removed coefficients do not scan all 64 bits.
+ */
+struct MaskEntry
+{
+    Mask m_mask = MaskAll;
+    std::vector<std::uint8_t> m_zeroed_positions{};
+};
+
+/** The entry which keeps all coefficients (chroma blocks, default mode). */
+extern const MaskEntry KeepAllEntry;
+
+/**
+ * @brief Class of the luma block by the number of nonzero AC coefficients
+ * among the first five in zigzag order. These coefficients are never zeroed
+ * out, so the class is known to both the transcoder and the transdecoder.
+ */
+enum class BlockClass : std::size_t
+{
+    FLAT,
+    SMOOTH,
+    TEXTURED,
+};
+
+inline static constexpr std::size_t BlockClassesCount = 3;
+
+const char * to_string(BlockClass block_class);
+
+/**
+ * @brief Cycles over the masks of zeroed out DCT coefficients.
+ *
+ * The masks are generated once per (power, masks count, seed) and shared by
+ * all filters with the same parameters. The mask of the k-th luma block in the
+ * scan order is the (k % masks count)-th one, so it can be taken either
+ * sequentially or directly by the block index.
+ */
 class DCTCoefficientsFilter
 {
 public:
     DCTCoefficientsFilter(const std::size_t power, std::size_t masks_count = 9, unsigned int seed = 42);
 
+    /**
+     * @brief Creates the filter which zeroes out more coefficients of the flat
+     * blocks and less of the textured ones than the given power.
+     */
+    static DCTCoefficientsFilter adaptive(const std::size_t power, std::size_t masks_count = 9, unsigned int seed = 42);
+
+    static BlockClass classify(const std::array<int, 64> & block);
+
+    /** Returns the number of coefficients zeroed out in the blocks of the class. */
+    std::size_t get_power(const BlockClass block_class) const;
+
     std::size_t get_masks_count() const;
 
     Mask get_mask();
 
+    /** Returns the entry of the next block and advances the filter. */
+    const MaskEntry & get_entry();
+
+    /**
+     * @brief Returns the entry of the next block and advances the filter.
+     *
+     * @param block The coefficients of the block in zigzag order, they choose
+     * the power of the adaptive filter.
+     */
+    const MaskEntry & get_entry(const std::array<int, 64> & block);
+
+    /** Returns the entry of the luma block with the given index in the scan order. */
+    const MaskEntry & get_entry(const std::size_t block_index, const BlockClass block_class = BlockClass::SMOOTH) const;
+
+    /** Makes the block with the given index the next one. */
+    void seek(const std::size_t block_index);
+
 private:
+    using Entries = std::shared_ptr<const std::vector<MaskEntry>>;
+
+    DCTCoefficientsFilter(const std::array<std::size_t, BlockClassesCount> & powers, std::size_t masks_count, unsigned int seed);
+
     std::size_t m_index = 0;
-    const std::vector<Mask> m_masks;
+    std::array<std::size_t, BlockClassesCount> m_powers;
+    std::array<Entries, BlockClassesCount> m_entries;
 };
 
 } // namespace utils
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 
 namespace utils {
 
@@ -27,6 +28,55 @@ public:
      * @param out
      */
     static void inverse(std::array<int, 64> & block, int stride, unsigned char * out);
+
+    /**
+     * @brief Apply an inverse (orthonormal, floating point) discrete cosine
+     * transform.
+     *
+     * @param block
+     */
+    static void inverse(std::array<float, 64> & block);
+
+    /**
+     * @brief Halves the resolution of four adjacent blocks in the DCT domain:
+     * the result is the (orthonormal) transform of the averages of every 2x2
+     * samples of the 16x16 area.
+     *
+     * @param blocks Top left, top right, bottom left and bottom right blocks
+     * of coefficients in natural order.
+     * @return The coefficients of the downsampled block in natural order.
+     */
+    static std::array<float, 64> downsample(const std::array<std::array<float, 64>, 4> & blocks);
+
+    /**
+     * @brief Apply a forward discrete cosine transform to every 8x8 block of
+     * the plane in place. The block rows are processed in parallel.
+     *
+     * A batch of N planes H x W is passed as one plane (N * H) x W.
+     *
+     * @param plane Samples of the plane stored row by row.
+     * @param height Height of the plane, multiple of 8.
+     * @param width Width of the plane, multiple of 8.
+     * @param threads_count Number of threads, 0 means the number of CPU cores.
+     */
+    static void forward(float * plane, std::size_t height, std::size_t width, std::size_t threads_count = 0);
+
+    /**
+     * @brief Apply an inverse (orthonormal, floating point) discrete cosine
+     * transform to every 8x8 block of the plane in place.
+     *
+     * @see forward(float *, std::size_t, std::size_t, std::size_t)
+     */
+    static void inverse(float * plane, std::size_t height, std::size_t width, std::size_t threads_count = 0);
+
+    /**
+     * @brief Apply an inverse discrete cosine transform of the decoder to every
+     * 8x8 block of the plane in place: the coefficients are replaced with the
+     * level shifted and clipped samples [0, 255].
+     *
+     * @see forward(float *, std::size_t, std::size_t, std::size_t)
+     */
+    static void inverse(int * plane, std::size_t height, std::size_t width, std::size_t threads_count = 0);
 };
 
 } // namespace utils
@@ -4,6 +4,7 @@
 #include "utils/output.hpp"
 
 #include <array>
+#include <optional>
 #include <fmt/core.h>
 
 namespace utils {
@@ -33,7 +34,8 @@ public:
     template <class InputIt>
     void perform_run_level_encoding(const InputIt & begin, const InputIt & end, Output & output, const Mask & mask = utils::MaskAll) const
     {
-        const auto placeholders = get_shortest_code_words_by_runs();
+        // The placeholders are needed only for the masked out coefficients
+        std::optional<std::array<Entry, 16>> placeholders;
         std::size_t i = 1, run = 0;
         for (InputIt it = begin; it != end; ++i, ++it) {
             const int ac = *it;
@@ -53,7 +55,10 @@ public:
             run &= 0xf;
 
             if (i < mask.size() && !mask[i]) {
-                const auto & placeholder = placeholders[run];
+                if (!placeholders.has_value()) {
+                    placeholders = get_shortest_code_words_by_runs();
+                }
+                const auto & placeholder = (*placeholders)[run];
                 output.write(placeholder.m_code, placeholder.m_length);
             }
             else {
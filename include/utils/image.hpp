@@ -59,6 +59,13 @@ public:
      */
     static Image from_ppm(const std::string & file_name);
 
+    /**
+     * @brief Writes image to .ppm file.
+     *
+     * @param file_name Name of file for image.
+     */
+    void to_ppm(const std::string & file_name) const;
+
     /**
      * @brief Get the width of the image.
      *
@@ -98,6 +105,18 @@ public:
      */
     YUVPixel get_yuv(std::size_t row, std::size_t column) const;
 
+    /**
+     * @brief Get the luminance at the specified row and column.
+     *
+     * For single-component images the pixel value is used as is, without
+     * color conversion.
+     *
+     * @param row The row index.
+     * @param column The column index.
+     * @return The luminance shifted to be centered around zero.
+     */
+    float get_luminance(std::size_t row, std::size_t column) const;
+
     /**
      * @brief Get the RGB components with the specified index in a linearized
      * representation.
@@ -140,6 +159,8 @@ private:
     std::size_t get(const unsigned char * component,
                     const std::size_t position) const;
 
+    std::size_t get_position(std::size_t row, std::size_t column) const;
+
     const Byte * get_bytes_ptr() const;
 
     friend Image & swap(Image & lhs, Image & rhs);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <utils/image.hpp>
+
+#include <istream>
+#include <optional>
+
+namespace utils {
+
+/**
+ * @brief A class for sequential reading of an image from a stream.
+ *
+ * The image is read in bands of rows, so only the current band is kept in
+ * memory. This allows to process images of any size coming from pipes.
+ */
+class ImageReader
+{
+public:
+    /**
+     * @brief Constructor for reading raw pixels from the stream.
+     *
+     * @param input The stream with pixels.
+     * @param width The width of the image.
+     * @param height The height of the image.
+     * @param components_count The number of color components in the image.
+     */
+    ImageReader(std::istream & input, std::size_t width, std::size_t height, std::size_t components_count);
+
+    /**
+     * @brief Reads .ppm header from the stream and prepares the reading of pixels.
+     *
+     * @param input The stream with .ppm image.
+     * @return Reader positioned at the first row of the image.
+     */
+    static ImageReader from_ppm(std::istream & input);
+
+    std::size_t get_width() const;
+
+    std::size_t get_height() const;
+
+    std::size_t get_components_count() const;
+
+    /**
+     * @brief Reads the next band of rows.
+     *
+     * @param rows_count The maximum number of rows in the band.
+     * @return Image containing the band, or nothing if all rows have been read.
+     */
+    std::optional<Image> read_rows(std::size_t rows_count);
+
+private:
+    std::istream & m_input;
+    const std::size_t m_width;
+    const std::size_t m_height;
+    const std::size_t m_components_count;
+    std::size_t m_rows_read = 0;
+};
+
+} // namespace utils
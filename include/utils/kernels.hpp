@@ -0,0 +1,77 @@
+#pragma once
+
+#include "utils/bytes.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+namespace utils {
+
+/**
+ * @brief Instruction sets the kernels are built for.
+ */
+enum class Isa
+{
+    SCALAR,
+    SSE42,
+    AVX2,
+    AVX512,
+};
+
+/**
+ * @brief Hot loops of the decoder and the encoder. Every kernel is built for
+ * each instruction set and the variant is selected at startup by cpuid.
+ * All the variants give the same results bit for bit.
+ */
+struct Kernels
+{
+    /** Integer inverse DCT, writes the level shifted and clipped samples. */
+    void (*m_inverse_dct)(std::array<int, 64> & block, int stride, Byte * out);
+
+    /** Forward DCT of the encoder, the coefficients are descaled. */
+    void (*m_forward_dct)(std::array<float, 64> & block);
+
+    /** Divides the coefficients by the divisors and rounds them, both in natural order. */
+    void (*m_quantize)(const std::array<float, 64> & block, const std::array<float, 64> & divisors, std::array<int, 64> & out);
+
+    /** Converts a row of YCbCr samples into interleaved RGB. */
+    void (*m_ycbcr_to_rgb)(const Byte * y, const Byte * cb, const Byte * cr, Byte * rgb, std::size_t width);
+
+    /**
+     * @brief Doubles the width of a row of at least 3 samples with the cubic
+     * filter. The last samples are taken from the end of the stride.
+     */
+    void (*m_upsample_row)(const Byte * in, std::size_t width, std::size_t stride, Byte * out);
+
+    /** Filters four rows: clip((w0 * a + w1 * b + w2 * c + w3 * d + 64) >> 7). */
+    void (*m_filter_rows)(const Byte * a, const Byte * b, const Byte * c, const Byte * d, const std::array<int, 4> & weights, Byte * out, std::size_t width);
+};
+
+/** Returns the best instruction set supported by the CPU. */
+Isa get_supported_isa();
+
+/** Returns the instruction set of the kernels in use. */
+Isa get_isa();
+
+/**
+ * @brief Makes the kernels built for the instruction set used instead of
+ * the detected one, e.g. to compare them in the benchmark.
+ *
+ * @throws std::runtime_error if the CPU does not support it.
+ */
+void force_isa(Isa isa);
+
+const Kernels & get_kernels();
+
+/**
+ * @brief Parses the name of the instruction set: scalar, sse4.2, avx2 or
+ * avx512.
+ *
+ * @throws std::invalid_argument for the unknown name.
+ */
+Isa parse_isa(const std::string & name);
+
+const char * to_string(Isa isa);
+
+} // namespace utils
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace utils {
+
+/**
+ * @brief Read-only view of a whole file mapped into memory. Only the pages
+ * actually read are loaded from the disk, so the headers of large files are
+ * parsed without reading the files. Without mmap (Windows) the file is read
+ * into memory.
+ */
+class MappedFile
+{
+public:
+    /**
+     * @throws std::runtime_error if the file cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::string & file_name);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    const unsigned char * data() const { return m_data; }
+
+    std::size_t size() const { return m_size; }
+
+private:
+    const unsigned char * m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+} // namespace utils
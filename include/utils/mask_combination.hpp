@@ -0,0 +1,42 @@
+#pragma once
+
+#include <utils/dct_coefficients_filter.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace utils {
+
+/**
+ * @brief Replaces the luma DCT coefficients of the predicted images with the
+ * coefficients of the original ones at the positions kept by the masks
+ * (the mask bits are indexed by the zigzag positions).
+ *
+ * The masks cycle over the luma blocks in the scan order of the decoder:
+ * row by row of MCUs, and row by row inside an MCU of the subsampled image
+ * (16x16 MCU of four blocks). The chroma of the predicted images is kept.
+ *
+ * RGB→Y, the block DCT, the merge, IDCT and Y→RGB are fused into one pass,
+ * the rows of blocks are processed in parallel.
+ *
+ * @param original Original images N x 3 x H x W with values in [0, 1].
+ * @param predicted Predicted images N x 3 x H x W with values in [0, 1].
+ * @param count Number of images N.
+ * @param height Height of the images, multiple of 8.
+ * @param width Width of the images, multiple of 8.
+ * @param subsampled For each image whether its chroma is subsampled (4:2:0).
+ * @param masks Masks of DCTCoefficientsFilter.
+ * @param output Combined images N x 3 x H x W with values in [0, 255].
+ * @param threads_count Number of threads, 0 means the number of CPU cores.
+ */
+void combine_images_with_masks(const float * original,
+                               const float * predicted,
+                               std::size_t count,
+                               std::size_t height,
+                               std::size_t width,
+                               const unsigned char * subsampled,
+                               const std::vector<Mask> & masks,
+                               int * output,
+                               std::size_t threads_count = 0);
+
+} // namespace utils
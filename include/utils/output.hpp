@@ -1,23 +1,52 @@
 #pragma once
 
 #include <utils/bytes.hpp>
+#include <ostream>
 #include <vector>
 
 class Output
 {
 public:
+    /**
+     * @brief Creates the output which only counts the bytes written to it,
+     * e.g. to measure the size of the image before writing it.
+     */
+    static Output counting();
+
     void to_file(const std::string & file_name) const;
 
+    /**
+     * @brief Writes the completed bytes to the stream and drops them from the
+     * output. Bits that do not form a byte yet stay in the buffer.
+     *
+     * @param stream The stream to write to.
+     */
+    void flush(std::ostream & stream);
+
     void reset();
 
+    /** Drops the written bytes and bits keeping the allocated memory. */
+    void clear();
+
     const std::vector<unsigned char> & get() const;
 
+    /** Returns the number of bits written since the last flush, the counted ones too. */
+    std::size_t get_bits_count() const;
+
     Output & write(unsigned short code, unsigned short lenght);
 
+    /** Pads the written bits with ones up to the byte boundary. */
+    Output & align();
+
     template <std::size_t BytesCount>
     Output & operator<<(const Bytes<BytesCount> & bytes)
     {
-        m_result.insert(m_result.end(), bytes.begin(), bytes.end());
+        if (m_is_counting) {
+            m_counted_bytes_count += BytesCount;
+        }
+        else {
+            m_result.insert(m_result.end(), bytes.begin(), bytes.end());
+        }
         return *this;
     }
 
@@ -25,6 +54,8 @@ public:
 
 private:
     std::vector<unsigned char> m_result{};
+    bool m_is_counting = false;
+    std::size_t m_counted_bytes_count = 0;
     int m_bits_buffer = 0;
     int m_bits_count = 0;
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/**
+ * @brief Calls the function for every index in [0, count) from several
+ * threads. The indices are distributed dynamically, one at a time.
+ * The first exception thrown by the function stops the remaining work and is
+ * rethrown after all threads are joined.
+ *
+ * @param count Number of indices.
+ * @param threads_count Number of threads, 0 means the number of CPU cores.
+ * @param function The function called with the index.
+ */
+template <class Function>
+void parallel_for(const std::size_t count, const std::size_t threads_count, Function && function)
+{
+    std::atomic<std::size_t> next{0};
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+    const auto worker = [&]() {
+        try {
+            for (auto i = next++; i < count; i = next++) {
+                function(i);
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+            next = count;
+        }
+    };
+
+    const auto workers_count = std::min<std::size_t>(
+            count,
+            threads_count != 0 ? threads_count : std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < workers_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+} // namespace utils
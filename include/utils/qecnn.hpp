@@ -0,0 +1,69 @@
+#pragma once
+
+#include <utils/convolution.hpp>
+#include <utils/image.hpp>
+
+#include <string>
+
+namespace utils {
+
+/**
+ * @brief CPU inference of QE-CNN-P quality enhancement model
+ * (see py/quality_enhancement/models.py).
+ *
+ * The image is processed by tiles with the overlap equal to the receptive
+ * field radius of the network, so the memory consumption is bounded and does
+ * not depend on the image size. The tiles are processed in parallel.
+ */
+class QECNN
+{
+public:
+    /**
+     * @brief Loads the model from the checkpoint converted by
+     * py/convert_checkpoint.py.
+     *
+     * @param file_name Name of file with converted checkpoint.
+     * @return Loaded model.
+     */
+    static QECNN from_file(const std::string & file_name);
+
+    /**
+     * @brief Sets the side of the square area produced by one tile.
+     *
+     * @param tile_size Size of the tile without the overlap.
+     * @return The model itself.
+     */
+    QECNN & set_tile_size(std::size_t tile_size);
+
+    /**
+     * @brief Sets the number of worker threads.
+     *
+     * @param threads_count Number of threads, 0 means the number of CPU cores.
+     * @return The model itself.
+     */
+    QECNN & set_threads_count(std::size_t threads_count);
+
+    /**
+     * @brief Enhances the quality of the decoded image.
+     *
+     * @param image The decoded image.
+     * @return Enhanced image with the same dimensions and components count.
+     */
+    Image enhance(const Image & image) const;
+
+private:
+    inline static constexpr std::size_t LayersCount = 9;
+
+    QECNN() = default;
+
+    void enhance_tile(const Image & image, std::size_t row, std::size_t column, std::vector<char> & result) const;
+
+    std::size_t get_overlap() const;
+
+    /** conv11..conv14, conv21..conv24 and conv5 layers. */
+    std::vector<Convolution> m_layers;
+    std::size_t m_tile_size = 96;
+    std::size_t m_threads_count = 0;
+};
+
+} // namespace utils
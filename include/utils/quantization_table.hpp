@@ -1,6 +1,7 @@
 #pragma once
 
 #include <utils/bytes.hpp>
+#include <utils/kernels.hpp>
 #include <utils/zigzag.hpp>
 
 namespace utils {
@@ -13,6 +14,9 @@ public:
         for (int i = 0; i < 64; ++i) {
             m_data[ZIGZAG_ORDER[i]] = quantization_table_value(data[i], quality);
         }
+        for (std::size_t j = 0; j < 64; ++j) {
+            m_divisors[j] = m_data[ZIGZAG_ORDER[j]];
+        }
     }
 
     const Bytes<64> & get() const
@@ -20,12 +24,19 @@ public:
         return m_data;
     }
 
+    /** Returns the scale of the base tables in percents for the quality from 1 to 100. */
+    static std::size_t get_scale(const std::size_t quality)
+    {
+        return quality < 50 ? 5000 / quality : 200 - quality * 2;
+    }
+
     std::array<int, 64> forward(const std::array<float, 64> & block) const
     {
+        std::array<int, 64> quantized;
+        get_kernels().m_quantize(block, m_divisors, quantized);
         std::array<int, 64> result;
         for (std::size_t j = 0; j < 64; ++j) {
-            const auto k = ZIGZAG_ORDER[j];
-            result[k] = round(block[j] / m_data[k]);
+            result[ZIGZAG_ORDER[j]] = quantized[j];
         }
         return result;
     }
@@ -46,12 +57,9 @@ private:
         return std::min(std::max(1, base), 255);
     }
 
-    static int round(const float v)
-    {
-        return static_cast<int>(v < 0 ? std::ceil(v - 0.5f) : std::floor(v + 0.5f));
-    }
-
     Bytes<64> m_data;
+    /** The values of the table in natural order. */
+    std::array<float, 64> m_divisors;
 };
 
 } // namespace utils
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+/**
+ * @brief Bounded lock-free queue between one producer thread and one
+ * consumer thread. The waiting threads yield and then sleep for a short
+ * time, so an idle stage of a pipeline does not occupy a core.
+ *
+ * The producer closes the queue after the last item, so the consumer still
+ * gets the items left in it. Any thread can cancel the queue, e.g. after an
+ * error, then the next push and pop of both sides fail even if there are
+ * items or free places left.
+ */
+template <class T>
+class SpscQueue
+{
+    inline static constexpr std::size_t YieldsCount = 64;
+    inline static constexpr std::chrono::microseconds SleepTime{100};
+
+public:
+    /** @param capacity Maximum number of the items in the queue, at least 1. */
+    explicit SpscQueue(const std::size_t capacity)
+        : m_items(capacity + 1)
+    {
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue & operator=(const SpscQueue &) = delete;
+
+    /**
+     * @brief Waits for a free place and adds the item.
+     *
+     * @return false if the queue is cancelled, the item is dropped then.
+     */
+    bool push(T item)
+    {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        const auto next = (tail + 1) % m_items.size();
+        for (std::size_t attempt = 0;; ++attempt) {
+            if (m_is_cancelled.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (next != m_head.load(std::memory_order_acquire)) {
+                break;
+            }
+            wait(attempt);
+        }
+        m_items[tail] = std::move(item);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Waits for an item and removes it.
+     *
+     * @return std::nullopt if the queue is closed and empty or it is cancelled.
+     */
+    std::optional<T> pop()
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        for (std::size_t attempt = 0;; ++attempt) {
+            if (m_is_cancelled.load(std::memory_order_acquire)) {
+                return std::nullopt;
+            }
+            if (head != m_tail.load(std::memory_order_acquire)) {
+                break;
+            }
+            // The queue is closed after the last push, so it is checked again
+            if (m_is_closed.load(std::memory_order_acquire) && head == m_tail.load(std::memory_order_acquire)) {
+                return std::nullopt;
+            }
+            wait(attempt);
+        }
+        std::optional<T> item{std::move(m_items[head])};
+        m_head.store((head + 1) % m_items.size(), std::memory_order_release);
+        return item;
+    }
+
+    /** Called by the producer after the last item. */
+    void close()
+    {
+        m_is_closed.store(true, std::memory_order_release);
+    }
+
+    void cancel()
+    {
+        m_is_cancelled.store(true, std::memory_order_release);
+    }
+
+private:
+    static void wait(const std::size_t attempt)
+    {
+        if (attempt < YieldsCount) {
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(SleepTime);
+        }
+    }
+
+    std::vector<T> m_items;
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    std::atomic<bool> m_is_closed{false};
+    std::atomic<bool> m_is_cancelled{false};
+};
+
+} // namespace utils
@@ -0,0 +1,87 @@
+import argparse
+import os
+import struct
+import sys
+import torch
+
+from array import array
+
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+
+from quality_enhancement.models import QECNN
+
+SIGNATURE = b"QECNN\x00\x00\x01"
+
+LAYERS = [
+    "conv11",
+    "conv12",
+    "conv13",
+    "conv14",
+    "conv21",
+    "conv22",
+    "conv23",
+    "conv24",
+    "conv5",
+]
+
+
+def _floats(tensor: torch.Tensor) -> bytes:
+    values = array("f", tensor.detach().float().contiguous().view(-1).tolist())
+    if sys.byteorder != "little":
+        values.byteswap()
+    return values.tobytes()
+
+
+def _split_layer(layer: torch.nn.Module) -> tuple[torch.nn.Conv2d, torch.nn.PReLU | None]:
+    if isinstance(layer, torch.nn.Sequential):
+        return layer[0], layer[1]
+    return layer, None
+
+
+def convert(checkpoint_file: str, output_file: str) -> None:
+    """
+    Converts the checkpoint of QECNN model into the file read by the C++
+    implementation of the model (utils::QECNN).
+
+    Parameters
+    ----------
+    checkpoint_file : str
+        Path to the checkpoint saved by py/main.py.
+    output_file : str
+        Path to the converted checkpoint.
+    """
+    model = QECNN()
+    checkpoint = torch.load(checkpoint_file, map_location="cpu")
+    model.load_state_dict(checkpoint["model_state_dict"])
+
+    with open(output_file, "wb") as output:
+        output.write(SIGNATURE)
+        for name in LAYERS:
+            convolution, activation = _split_layer(getattr(model, name))
+            output.write(
+                struct.pack(
+                    "<4I",
+                    convolution.in_channels,
+                    convolution.out_channels,
+                    convolution.kernel_size[0],
+                    0 if activation is None else activation.num_parameters,
+                )
+            )
+            output.write(_floats(convolution.weight))
+            output.write(_floats(convolution.bias))
+            if activation is not None:
+                output.write(_floats(activation.weight))
+
+
+if __name__ == "__main__":
+    """
+    python3 py/convert_checkpoint.py -i "py/checkpoints/20240501120000.pth" -o "qecnn.bin"
+    """
+    parser = argparse.ArgumentParser(
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter
+    )
+    parser.add_argument("-i", "--input_file", type=str, required=True)
+    parser.add_argument("-o", "--output_file", type=str, required=True)
+
+    args = parser.parse_args()
+    convert(args.input_file, args.output_file)
@@ -37,6 +37,7 @@ def call_decoder_for_image(
     mode: str | None,
     power: int,
     enhanced_folder: str | None,
+    arithmetic_coding: bool = False,
 ):
     _, file_name = os.path.split(input_file)
     file_name, extension = os.path.splitext(file_name)
@@ -55,6 +56,8 @@ def call_decoder_for_image(
         if not os.path.exists(enhanced_file):
             return
         command = f"{command} -e {enhanced_file}"
+    if mode == "--encode_residuals" and arithmetic_coding:
+        command = f"{command} --arithmetic"
 
     os.system(command)
 
@@ -162,6 +165,7 @@ def call_decoder_for_images(
     power: int | None,
     limit: int | None,
     enhanced_folder: str | None,
+    arithmetic_coding: bool = False,
 ) -> None:
     process_images_parallel(
         call_decoder_for_image,
@@ -172,6 +176,7 @@ def call_decoder_for_images(
         mode=mode,
         power=power,
         enhanced_folder=enhanced_folder,
+        arithmetic_coding=arithmetic_coding,
     )
 
 
@@ -312,6 +317,9 @@ def main() -> int:
     - To transcode images after processing them with QE-CNN:
     python3 py/process_images.py --encode_residuals -i "images/02-croped" -o "images/06-transcoded" -e "images/05-enhanced" --power 16
 
+    - To transcode images writing the residuals with the built-in arithmetic coder:
+    python3 py/process_images.py --encode_residuals --arithmetic_coding -i "images/02-croped" -o "images/06-transcoded" -e "images/05-enhanced" --power 16
+
     - To replace Huffman coding with arithmetic coding using Jpegtran:
     python3 py/process_images.py --arithmetic -i "images/02-croped" -o "images/08-jpegtran-output"
     python3 py/process_images.py --arithmetic -i "images/06-transcoded" -o "images/09-jpegtran-output-for-transcoded"
@@ -357,6 +365,11 @@ def main() -> int:
     parser.add_argument("--width", "-W", type=int, help="Width for cropping")
     parser.add_argument("--height", "-H", type=int, help="Height for cropping")
     parser.add_argument("--power", "-p", type=int)
+    parser.add_argument(
+        "--arithmetic_coding",
+        action="store_true",
+        help="Write the residuals with the built-in arithmetic coder of the decoder instead of calling jpegtran",
+    )
     parser.add_argument("--limit", "-l", type=int)
     parser.add_argument("--validation_size", type=float, default=0.1)
     parser.add_argument("--test_size", type=float, default=0.2)
@@ -418,6 +431,7 @@ def main() -> int:
             power=args.power,
             limit=args.limit,
             enhanced_folder=args.enhanced_folder,
+            arithmetic_coding=args.arithmetic_coding,
         )
         ####
 
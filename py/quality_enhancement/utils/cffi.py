@@ -1,6 +1,8 @@
+import numpy as np
+
 from cffi import FFI
 
-__all__ = ["LibUtils"]
+__all__ = ["LibUtils", "LibTranscoder", "TranscoderError"]
 
 class LibUtils:
     def __init__(self):
@@ -11,6 +13,12 @@ class LibUtils:
             size_t get_dct_filter_masks_count(const size_t power);
             size_t * get_dct_filter_masks(const size_t power);
             void free_masks(size_t * masks);
+            int forward_discrete_cosine_transform_planes(float * planes, size_t count, size_t height, size_t width, size_t threads_count);
+            int inverse_discrete_cosine_transform_planes(float * planes, size_t count, size_t height, size_t width, size_t threads_count);
+            int inverse_discrete_cosine_transform_int_planes(int * planes, size_t count, size_t height, size_t width, size_t threads_count);
+            int combine_images_with_masks(const float * original, const float * predicted, size_t count, size_t height,
+                                          size_t width, const unsigned char * subsampled, const size_t * masks,
+                                          size_t masks_count, int * output, size_t threads_count);
             """
         )
 
@@ -22,3 +30,165 @@ class LibUtils:
         ]
         self._lib.free_masks(masks)
         return result
+
+    def forward_dct(self, planes: np.ndarray, threads_count: int = 0) -> None:
+        """
+        Applies DCT (orthonormal) to every 8x8 block of the planes in place.
+        The array has the shape (..., height, width) and float32 type.
+        """
+        self._transform_planes(self._lib.forward_discrete_cosine_transform_planes, "float[]", planes, threads_count)
+
+    def inverse_dct(self, planes: np.ndarray, threads_count: int = 0) -> None:
+        """
+        Applies inverse DCT to every 8x8 block of the planes in place. For int32
+        planes the integer IDCT of the decoder is used, which produces the level
+        shifted and clipped samples.
+        """
+        if planes.dtype == np.int32:
+            function, ctype = self._lib.inverse_discrete_cosine_transform_int_planes, "int[]"
+        else:
+            function, ctype = self._lib.inverse_discrete_cosine_transform_planes, "float[]"
+        self._transform_planes(function, ctype, planes, threads_count)
+
+    def combine_images_with_masks(
+        self,
+        original: np.ndarray,
+        predicted: np.ndarray,
+        masks: list[list[bool]],
+        subsampled: np.ndarray,
+        threads_count: int = 0,
+    ) -> np.ndarray:
+        """
+        Replaces the luma DCT coefficients of the predicted images (N x 3 x H x W,
+        values in [0, 1]) with the ones of the original images at the positions
+        kept by the masks. Returns int32 RGB images N x 3 x H x W.
+        """
+        original = np.ascontiguousarray(original, dtype=np.float32)
+        predicted = np.ascontiguousarray(predicted, dtype=np.float32)
+        subsampled = np.ascontiguousarray(subsampled, dtype=np.uint8)
+        packed_masks = self._ffi.new(
+            "size_t[]", [sum(1 << i for i, keep in enumerate(mask) if keep) for mask in masks]
+        )
+        count, _, height, width = original.shape
+        result = np.empty(original.shape, dtype=np.int32)
+        status = self._lib.combine_images_with_masks(
+            self._ffi.from_buffer("float[]", original),
+            self._ffi.from_buffer("float[]", predicted),
+            count,
+            height,
+            width,
+            self._ffi.from_buffer("unsigned char[]", subsampled),
+            packed_masks,
+            len(masks),
+            self._ffi.from_buffer("int[]", result),
+            threads_count,
+        )
+        if status != 0:
+            raise ValueError(f"Invalid images of shape {original.shape} or empty masks")
+        return result
+
+    def _transform_planes(self, function, ctype: str, planes: np.ndarray, threads_count: int) -> None:
+        if not planes.flags.c_contiguous or planes.ndim < 2:
+            raise ValueError("Contiguous array of shape (..., height, width) is expected")
+        height, width = planes.shape[-2:]
+        count = planes.size // (height * width) if planes.size else 0
+        status = function(self._ffi.from_buffer(ctype, planes), count, height, width, threads_count)
+        if status != 0:
+            raise ValueError(f"Dimensions of the planes must be multiples of 8: {planes.shape}")
+
+
+class TranscoderError(RuntimeError):
+    pass
+
+
+class LibTranscoder:
+    """
+    Bindings of the C interface of the transcoder (include/transcoder/transcoder.h),
+    which works from memory to memory without spawning the Decoder process.
+    """
+
+    _OK = 0
+    _BUFFER_TOO_SMALL = 6
+
+    def __init__(self, path: str = "../build/libTranscoder.dylib"):
+        self._ffi = FFI()
+        self._ffi.cdef(
+            """
+            struct transcoder_image_info
+            {
+                size_t width;
+                size_t height;
+                size_t components_count;
+            };
+            const char * transcoder_status_name(int status);
+            int transcoder_read_info(const unsigned char * jpeg, size_t jpeg_size, struct transcoder_image_info * info);
+            int transcoder_decode(const unsigned char * jpeg, size_t jpeg_size, unsigned char * pixels,
+                                  size_t pixels_capacity, struct transcoder_image_info * info);
+            int transcoder_zero_out_and_decode(const unsigned char * jpeg, size_t jpeg_size, size_t power,
+                                               unsigned char * pixels, size_t pixels_capacity,
+                                               struct transcoder_image_info * info);
+            int transcoder_encode_residuals(const unsigned char * jpeg, size_t jpeg_size, size_t power,
+                                            const unsigned char * enhanced,
+                                            const struct transcoder_image_info * enhanced_info,
+                                            unsigned char * output, size_t output_capacity, size_t * output_size);
+            int transcoder_decode_residuals(const unsigned char * jpeg, size_t jpeg_size, size_t power,
+                                            const unsigned char * enhanced,
+                                            const struct transcoder_image_info * enhanced_info,
+                                            unsigned char * output, size_t output_capacity, size_t * output_size);
+            """
+        )
+        self._lib = self._ffi.dlopen(path)
+
+    def _check(self, status: int) -> None:
+        if status != self._OK:
+            name = self._ffi.string(self._lib.transcoder_status_name(status)).decode()
+            raise TranscoderError(f"Transcoder failed: {name}")
+
+    def decode(self, jpeg: bytes, power: int | None = None) -> np.ndarray:
+        """
+        Decodes JPEG into the array of shape (height, width, components).
+        If the power is given, the DCT coefficients are zeroed out.
+        """
+        info = self._ffi.new("struct transcoder_image_info *")
+        self._check(self._lib.transcoder_read_info(jpeg, len(jpeg), info))
+
+        result = np.empty((info.height, info.width, info.components_count), dtype=np.uint8)
+        pixels = self._ffi.from_buffer("unsigned char[]", result)
+        if power is None:
+            status = self._lib.transcoder_decode(jpeg, len(jpeg), pixels, result.nbytes, info)
+        else:
+            status = self._lib.transcoder_zero_out_and_decode(jpeg, len(jpeg), power, pixels, result.nbytes, info)
+        self._check(status)
+        return result
+
+    def encode_residuals(self, jpeg: bytes, enhanced: np.ndarray, power: int) -> bytes:
+        return self._process_residuals(self._lib.transcoder_encode_residuals, jpeg, enhanced, power)
+
+    def decode_residuals(self, jpeg: bytes, enhanced: np.ndarray, power: int) -> bytes:
+        return self._process_residuals(self._lib.transcoder_decode_residuals, jpeg, enhanced, power)
+
+    def _process_residuals(self, function, jpeg: bytes, enhanced: np.ndarray, power: int) -> bytes:
+        enhanced = np.ascontiguousarray(enhanced, dtype=np.uint8)
+        info = self._ffi.new("struct transcoder_image_info *")
+        info.height, info.width = enhanced.shape[:2]
+        info.components_count = 1 if enhanced.ndim == 2 else enhanced.shape[2]
+
+        output_size = self._ffi.new("size_t *")
+        capacity = 2 * len(jpeg)
+        while True:
+            output = self._ffi.new("unsigned char[]", capacity)
+            status = function(
+                jpeg,
+                len(jpeg),
+                power,
+                self._ffi.from_buffer("unsigned char[]", enhanced),
+                info,
+                output,
+                capacity,
+                output_size,
+            )
+            if status != self._BUFFER_TOO_SMALL:
+                break
+            capacity = output_size[0]
+        self._check(status)
+        return bytes(self._ffi.buffer(output, output_size[0]))
@@ -1,10 +1,43 @@
 import torch
 
 from torch_dct import dct_2d, idct_2d
+from .cffi import LibUtils
 from .converters import get_luminance_from_rgb, to_yuv, to_rgb
 
 __all__ = ["dct", "idct", "combine_images_with_masks"]
 
+_lib_utils = None
+
+
+def _get_lib_utils() -> LibUtils | None:
+    global _lib_utils
+    if _lib_utils is None:
+        try:
+            _lib_utils = LibUtils()
+        except OSError:
+            _lib_utils = False
+    return _lib_utils or None
+
+
+def _transform_planes_natively(method: str, components: torch.Tensor) -> bool:
+    """
+    Transforms the planes in place by the Utils library, if it is available and
+    the tensor can be shared with it without copying.
+    """
+    lib = _get_lib_utils()
+    if (
+        lib is None
+        or components.device.type != "cpu"
+        or components.dtype != torch.float32
+        or components.requires_grad
+        or not components.is_contiguous()
+        or components.shape[-1] % 8 != 0
+        or components.shape[-2] % 8 != 0
+    ):
+        return False
+    getattr(lib, method)(components.numpy())
+    return True
+
 
 def _transform_blocks(
     function: callable, components: torch.Tensor, *args, **kwargs
@@ -20,10 +53,14 @@ def _transform_blocks(
 
 
 def dct(components: torch.Tensor) -> torch.Tensor:
+    if _transform_planes_natively("forward_dct", components):
+        return components
     return _transform_blocks(dct_2d, components, norm="ortho")
 
 
 def idct(components: torch.Tensor) -> torch.Tensor:
+    if _transform_planes_natively("inverse_dct", components):
+        return components
     return _transform_blocks(idct_2d, components, norm="ortho")
 
 
@@ -67,7 +104,7 @@ def _combine_ys_with_masks(
             predicted_block = predicted_dct[block_indexes]
             if sampling != 1:
                 _combine_ys_with_masks(
-                    original_block, predicted_block, masks, sampling, block_id
+                    original_block, predicted_block, masks, 1, block_id
                 )
             else:  # block 8x8
                 mask = masks[block_id % len(masks)]
@@ -86,13 +123,29 @@ def combine_images_with_masks(
     masks: list[list[bool]],
     sampling: torch.Tensor,
 ) -> torch.Tensor:
-    original_dct = dct(get_luminance_from_rgb(original_images, scaled=True))
+    lib = _get_lib_utils()
+    if (
+        lib is not None
+        and original_images.device.type == "cpu"
+        and predicted_images.device.type == "cpu"
+        and original_images.shape[-1] % 8 == 0
+        and original_images.shape[-2] % 8 == 0
+    ):
+        result = lib.combine_images_with_masks(
+            original_images.detach().numpy(),
+            predicted_images.detach().numpy(),
+            masks,
+            (sampling != 0).numpy(),
+        )
+        return torch.from_numpy(result)
+
+    original_dct = dct(get_luminance_from_rgb(original_images * 255.0))
     predicted_yuv = to_yuv(predicted_images * 255.0)
     dct(predicted_yuv[:, :, :, 0])
     for i in range(len(sampling)):
         _combine_ys_with_masks(
-            original_dct=original_dct[i],
-            predicted_dct=predicted_yuv[i, :, :, 0],
+            original_dct=original_dct[i : i + 1],
+            predicted_dct=predicted_yuv[i : i + 1, :, :, 0],
             masks=masks,
             sampling=1 if sampling[i] == 0 else 2,
         )
@@ -0,0 +1,543 @@
+#include "decoder/decoder.hpp"
+#include "decoder/decoding_exception.hpp"
+#include "encoder/encoder.hpp"
+#include "utils/image.hpp"
+#include "utils/image_reader.hpp"
+#include "utils/kernels.hpp"
+#include "utils/parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Third-party:
+#include <args.hxx>
+#include <fmt/core.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Mode
+{
+    DECODE,
+    ZERO_OUT_AND_DECODE,
+    ENCODE_RESIDUALS,
+    DECODE_RESIDUALS,
+    TRANSCODE,
+    TRANSDECODE,
+    ENCODE,
+};
+
+inline static constexpr std::pair<Mode, const char *> Modes[] = {
+        {Mode::DECODE, "decode"},
+        {Mode::ZERO_OUT_AND_DECODE, "zero-out-and-decode"},
+        {Mode::ENCODE_RESIDUALS, "encode-residuals"},
+        {Mode::DECODE_RESIDUALS, "decode-residuals"},
+        {Mode::TRANSCODE, "transcode"},
+        {Mode::TRANSDECODE, "transdecode"},
+        {Mode::ENCODE, "encode"},
+};
+
+struct Settings
+{
+    std::size_t m_power = 16;
+    int m_quality = 90;
+};
+
+/**
+ * @brief Image of the corpus with the inputs of every mode prepared before
+ * the measurements.
+ */
+struct CorpusImage
+{
+    std::string m_file_name;
+    BytesList m_jpeg;
+    std::size_t m_width = 0;
+    std::size_t m_height = 0;
+    std::size_t m_components_count = 0;
+    /** Decoded pixels, the input of the encoder. */
+    BytesList m_pixels;
+    /**
+     * The image decoded with zeroed out coefficients. It is used as
+     * the enhanced image, so the network does not affect the measurements.
+     */
+    std::vector<char> m_enhanced;
+    BytesList m_residuals;
+    BytesList m_transcoded;
+
+    utils::Image get_enhanced_image() const
+    {
+        return {m_width, m_height, m_components_count, std::vector<char>(m_enhanced)};
+    }
+
+    const BytesList & get_input(const Mode mode) const
+    {
+        switch (mode) {
+        case Mode::DECODE_RESIDUALS:
+            return m_residuals;
+        case Mode::TRANSDECODE:
+            return m_transcoded;
+        case Mode::ENCODE:
+            return m_pixels;
+        default:
+            return m_jpeg;
+        }
+    }
+};
+
+struct Result
+{
+    std::string m_mode;
+    std::size_t m_threads_count = 0;
+    double m_images_per_second = 0;
+    double m_megapixels_per_second = 0;
+    double m_megabytes_per_second = 0;
+    double m_latency_p50 = 0;
+    double m_latency_p99 = 0;
+};
+
+enum class Comparison
+{
+    PASSED,
+    REGRESSED,
+    /** The baseline was measured with the kernels for another instruction set. */
+    SKIPPED,
+};
+
+const char * to_string(const Mode mode)
+{
+    for (const auto & [value, name] : Modes) {
+        if (value == mode) {
+            return name;
+        }
+    }
+    return "";
+}
+
+std::vector<Mode> parse_modes(const std::string & list)
+{
+    std::vector<Mode> modes;
+    std::istringstream stream(list);
+    for (std::string name; std::getline(stream, name, ',');) {
+        if (name == "all") {
+            for (const auto & [value, _] : Modes) {
+                modes.push_back(value);
+            }
+            continue;
+        }
+        const auto it = std::find_if(std::begin(Modes), std::end(Modes), [&name](const auto & mode) { return name == mode.second; });
+        if (it == std::end(Modes)) {
+            throw std::invalid_argument("Unknown mode: " + name);
+        }
+        modes.push_back(it->first);
+    }
+    return modes;
+}
+
+/** Returns the thread counts 1, 2, 4, ... up to the maximal one inclusive. */
+std::vector<std::size_t> get_threads_counts(const std::size_t max_threads_count)
+{
+    std::vector<std::size_t> counts;
+    for (std::size_t count = 1; count < max_threads_count; count *= 2) {
+        counts.push_back(count);
+    }
+    counts.push_back(max_threads_count);
+    return counts;
+}
+
+double get_peak_rss_megabytes()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024. * 1024.);
+#else
+    return usage.ru_maxrss / 1024.;
+#endif
+#endif
+}
+
+BytesList read_file(const std::filesystem::path & path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening input file: " + path.string());
+    }
+    return {std::istreambuf_iterator<char>(file), {}};
+}
+
+std::unique_ptr<Decoder> make_decoder(const CorpusImage & image, const Decoder::Mode mode, const Settings & settings)
+{
+    auto decoder = std::make_unique<Decoder>();
+    decoder->toggle_mode(mode);
+    if (mode != Decoder::Mode::DEFAULT) {
+        decoder->set_dct_filter(settings.m_power);
+    }
+    if (mode == Decoder::Mode::ENCODE_RESIDUALS || mode == Decoder::Mode::DECODE_RESIDUALS) {
+        decoder->set_enhanced_image(image.get_enhanced_image());
+    }
+    if (mode == Decoder::Mode::TRANSCODE || mode == Decoder::Mode::TRANSDECODE) {
+        decoder->set_enhancer([&image](const utils::Image &) { return image.get_enhanced_image(); });
+    }
+    return decoder;
+}
+
+BytesList encode(const CorpusImage & image, const Settings & settings)
+{
+    std::istringstream input(std::string(image.m_pixels.begin(), image.m_pixels.end()));
+    utils::ImageReader reader(input, image.m_width, image.m_height, image.m_components_count);
+    std::ostringstream output;
+    Encoder::encode(reader, output, settings.m_quality);
+    const auto bytes = output.str();
+    return {bytes.begin(), bytes.end()};
+}
+
+double run(const CorpusImage & image, Mode mode, const Settings & settings);
+
+/**
+ * @brief Decodes the image in every mode once to get the inputs of the
+ * residual modes and of the encoder.
+ */
+CorpusImage prepare(const std::filesystem::path & path, const Settings & settings)
+{
+    CorpusImage image;
+    image.m_file_name = path.string();
+    image.m_jpeg = read_file(path);
+
+    auto decoder = make_decoder(image, Decoder::Mode::DEFAULT, settings);
+    decoder->decode(image.m_jpeg);
+    image.m_width = decoder->get_width();
+    image.m_height = decoder->get_height();
+    image.m_components_count = decoder->is_color_image() ? 3 : 1;
+    const auto & pixels = decoder->get_image();
+    image.m_pixels.assign(pixels.begin(), pixels.begin() + decoder->get_image_size());
+
+    decoder = make_decoder(image, Decoder::Mode::ZERO_OUT_AND_DECODE, settings);
+    decoder->decode(image.m_jpeg);
+    const auto & zeroed = decoder->get_image();
+    image.m_enhanced.assign(zeroed.begin(), zeroed.begin() + decoder->get_image_size());
+
+    decoder = make_decoder(image, Decoder::Mode::ENCODE_RESIDUALS, settings);
+    decoder->decode(image.m_jpeg);
+    image.m_residuals = decoder->get_output().get();
+
+    decoder = make_decoder(image, Decoder::Mode::TRANSCODE, settings);
+    decoder->decode(image.m_jpeg);
+    image.m_transcoded = decoder->get_output().get();
+
+    // The residuals are decoded once to skip the images they cannot be decoded for
+    run(image, Mode::DECODE_RESIDUALS, settings);
+    run(image, Mode::TRANSDECODE, settings);
+    return image;
+}
+
+std::vector<CorpusImage> load_corpus(const std::string & directory, const Settings & settings)
+{
+    std::vector<std::filesystem::path> paths;
+    for (const auto & entry : std::filesystem::directory_iterator(directory)) {
+        auto extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+        if (entry.is_regular_file() && (extension == ".jpg" || extension == ".jpeg")) {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<CorpusImage> corpus;
+    for (const auto & path : paths) {
+        try {
+            corpus.push_back(prepare(path, settings));
+        }
+        catch (const DecodingException & e) {
+            std::cerr << "Skipping " << path.string() << ": " << e.what() << std::endl;
+        }
+    }
+    if (corpus.empty()) {
+        throw std::runtime_error("No decodable JPEG images in " + directory);
+    }
+    return corpus;
+}
+
+/**
+ * @brief Reads the identity of the corpus written by CorpusGenerator.
+ *
+ * @return The JSON object of the identity or an empty string if the corpus
+ * was not generated.
+ */
+std::string read_corpus_identity(const std::string & directory)
+{
+    std::ifstream file(std::filesystem::path(directory) / "corpus.json");
+    std::string identity;
+    std::getline(file, identity);
+    return identity;
+}
+
+/** Runs the mode on the image and returns the latency in milliseconds. */
+double run(const CorpusImage & image, const Mode mode, const Settings & settings)
+{
+    if (mode == Mode::ENCODE) {
+        const auto start = Clock::now();
+        encode(image, settings);
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    static constexpr Decoder::Mode DecoderModes[] = {
+            Decoder::Mode::DEFAULT,
+            Decoder::Mode::ZERO_OUT_AND_DECODE,
+            Decoder::Mode::ENCODE_RESIDUALS,
+            Decoder::Mode::DECODE_RESIDUALS,
+            Decoder::Mode::TRANSCODE,
+            Decoder::Mode::TRANSDECODE,
+    };
+    auto decoder = make_decoder(image, DecoderModes[static_cast<std::size_t>(mode)], settings);
+    const auto & input = image.get_input(mode);
+    const auto start = Clock::now();
+    decoder->decode(input);
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double get_percentile(const std::vector<double> & sorted, const double percentile)
+{
+    const auto rank = static_cast<std::size_t>(std::ceil(percentile * sorted.size()));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+Result measure(const std::vector<CorpusImage> & corpus, const Mode mode, const std::size_t threads_count, const std::size_t repeats, const Settings & settings)
+{
+    std::vector<double> latencies(corpus.size() * repeats);
+    const auto start = Clock::now();
+    utils::parallel_for(latencies.size(), threads_count, [&](const std::size_t i) {
+        latencies[i] = run(corpus[i % corpus.size()], mode, settings);
+    });
+    const auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double megapixels = 0, megabytes = 0;
+    for (const auto & image : corpus) {
+        megapixels += image.m_width * image.m_height / 1e6;
+        megabytes += image.get_input(mode).size() / 1e6;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    Result result;
+    result.m_mode = to_string(mode);
+    result.m_threads_count = threads_count;
+    result.m_images_per_second = latencies.size() / seconds;
+    result.m_megapixels_per_second = megapixels * repeats / seconds;
+    result.m_megabytes_per_second = megabytes * repeats / seconds;
+    result.m_latency_p50 = get_percentile(latencies, 0.5);
+    result.m_latency_p99 = get_percentile(latencies, 0.99);
+    return result;
+}
+
+/**
+ * @brief Writes the results as JSON, one result per line, so the baseline
+ * can be read back without JSON library. The peak memory is the one of the
+ * whole process, since it never goes down between the measurements.
+ */
+void write_json(std::ostream & stream, const std::string & corpus_identity, const std::vector<CorpusImage> & corpus, const std::vector<Result> & results)
+{
+    double megapixels = 0, megabytes = 0;
+    for (const auto & image : corpus) {
+        megapixels += image.m_width * image.m_height / 1e6;
+        megabytes += image.m_jpeg.size() / 1e6;
+    }
+    stream << fmt::format("{{\n  \"corpus\": {},\n  \"images\": {},\n  \"megapixels\": {:.3f},\n  \"megabytes\": {:.3f},\n  \"isa\": \"{}\",\n  \"peak_rss_mb\": {:.1f},\n  \"results\": [\n",
+                          corpus_identity.empty() ? "null" : corpus_identity,
+                          corpus.size(),
+                          megapixels,
+                          megabytes,
+                          utils::to_string(utils::get_isa()),
+                          get_peak_rss_megabytes());
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto & r = results[i];
+        stream << fmt::format("    {{\"mode\": \"{}\", \"threads\": {}, \"images_per_second\": {:.3f}, \"megapixels_per_second\": {:.3f}, "
+                              "\"megabytes_per_second\": {:.3f}, \"latency_p50_ms\": {:.3f}, \"latency_p99_ms\": {:.3f}}}{}\n",
+                              r.m_mode,
+                              r.m_threads_count,
+                              r.m_images_per_second,
+                              r.m_megapixels_per_second,
+                              r.m_megabytes_per_second,
+                              r.m_latency_p50,
+                              r.m_latency_p99,
+                              i + 1 < results.size() ? "," : "");
+    }
+    stream << "  ]\n}\n";
+}
+
+/**
+ * @brief Compares the throughput in megapixels per second with the baseline
+ * written by the same program. The results missing in the baseline are not
+ * compared.
+ *
+ * The results are not compared if the baseline was measured with the kernels
+ * for another instruction set, so a slower machine does not look like a
+ * regression.
+ *
+ * @throws std::runtime_error if the baseline was measured on another corpus,
+ * the corpus is not generated by CorpusGenerator or the baseline does not
+ * record its corpus and instruction set.
+ * @return Whether some result is slower than the baseline by more than
+ * the threshold.
+ */
+Comparison compare_with_baseline(const std::string & file_name, const std::string & corpus_identity, const std::vector<Result> & results, const double threshold)
+{
+    std::ifstream file(file_name);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening baseline file: " + file_name);
+    }
+    static const std::regex Corpus(R"re("corpus": (.*),$)re");
+    static const std::regex Isa(R"re("isa": "([a-z0-9.]+)")re");
+    static const std::regex Entry(R"re("mode": "([a-z-]+)", "threads": (\d+), "images_per_second": [0-9.eE+-]+, "megapixels_per_second": ([0-9.eE+-]+))re");
+
+    const std::string isa = utils::to_string(utils::get_isa());
+    std::string baseline_corpus_identity, baseline_isa;
+    auto comparison = Comparison::PASSED;
+    for (std::string line; std::getline(file, line);) {
+        std::smatch match;
+        if (std::regex_search(line, match, Corpus)) {
+            baseline_corpus_identity = match[1];
+            if (corpus_identity.empty() || baseline_corpus_identity != corpus_identity) {
+                throw std::runtime_error(fmt::format("The baseline was measured on the corpus {}, it cannot be compared with the results on {}",
+                                                     baseline_corpus_identity,
+                                                     corpus_identity.empty() ? "the corpus not generated by CorpusGenerator" : corpus_identity));
+            }
+            continue;
+        }
+        if (std::regex_search(line, match, Isa)) {
+            baseline_isa = match[1];
+            if (baseline_isa != isa) {
+                std::cerr << fmt::format("The baseline was measured with the {} kernels, the results with the {} ones are not compared\n", baseline_isa, isa);
+                return Comparison::SKIPPED;
+            }
+            continue;
+        }
+        if (!std::regex_search(line, match, Entry)) {
+            continue;
+        }
+        if (baseline_corpus_identity.empty() || baseline_isa.empty()) {
+            throw std::runtime_error("The corpus or the instruction set of the baseline is unknown: " + file_name);
+        }
+        const auto threads_count = std::stoul(match[2]);
+        const auto baseline = std::stod(match[3]);
+        for (const auto & result : results) {
+            if (result.m_mode != match[1] || result.m_threads_count != threads_count) {
+                continue;
+            }
+            const auto change = 100. * (result.m_megapixels_per_second / baseline - 1.);
+            if (change < -threshold) {
+                std::cerr << fmt::format("Throughput regression in {} mode at {} threads: {:.3f} MP/s, baseline {:.3f} MP/s ({:+.1f}%)\n",
+                                         result.m_mode,
+                                         threads_count,
+                                         result.m_megapixels_per_second,
+                                         baseline,
+                                         change);
+                comparison = Comparison::REGRESSED;
+            }
+        }
+    }
+    return comparison;
+}
+
+} // namespace
+
+int main(int argc, const char * argv[])
+{
+    args::ArgumentParser parser("JPEG transcoder throughput benchmark");
+
+    args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+
+    args::ValueFlag<std::string> input_directory(parser, "input_directory", "The directory with JPEG images", {'i', "input"}, args::Options::Required);
+    args::ValueFlag<std::string> output_file_name(parser, "output_file_name", "The output .json file name, stdout by default", {'o', "output"});
+    args::ValueFlag<std::string> modes_list(parser, "modes", "Comma-separated modes to measure or 'all'", {"modes"}, "all");
+    args::ValueFlag<std::size_t> threads_count(parser, "threads", "The maximal number of threads, 0 means all CPU cores", {'t', "threads"}, 0);
+    args::ValueFlag<std::size_t> repeats(parser, "repeats", "The number of passes over the corpus in every measurement", {'r', "repeats"}, 3);
+    args::ValueFlag<std::size_t> power(parser, "power", "The power of the DCT coefficient filter", {'p', "power"}, 16);
+    args::ValueFlag<int> quality(parser, "quality", "Encoding quality", {'q', "quality"}, 90);
+    args::ValueFlag<std::string> baseline_file_name(parser, "baseline", "The .json file written by the benchmark earlier", {"baseline"});
+    args::ValueFlag<double> threshold(parser, "threshold", "The allowed drop of the throughput below the baseline in percent", {"threshold"}, 10);
+    args::ValueFlag<std::string> isa(parser, "isa", "Use the kernels built for the instruction set: scalar, sse4.2, avx2 or avx512", {"force-isa"});
+
+    try {
+        parser.ParseCLI(argc, argv);
+
+        if (isa) {
+            utils::force_isa(utils::parse_isa(args::get(isa)));
+        }
+
+        const Settings settings{args::get(power), args::get(quality)};
+        const auto modes = parse_modes(args::get(modes_list));
+        const auto max_threads_count = args::get(threads_count) != 0 ? args::get(threads_count) : std::max(1u, std::thread::hardware_concurrency());
+        const auto corpus = load_corpus(args::get(input_directory), settings);
+        const auto corpus_identity = read_corpus_identity(args::get(input_directory));
+
+        std::vector<Result> results;
+        for (const auto mode : modes) {
+            for (const auto count : get_threads_counts(max_threads_count)) {
+                results.push_back(measure(corpus, mode, count, std::max<std::size_t>(1, args::get(repeats)), settings));
+                std::cerr << fmt::format("{} x{}: {:.1f} images/s\n", to_string(mode), count, results.back().m_images_per_second);
+            }
+        }
+
+        if (output_file_name) {
+            std::ofstream output(args::get(output_file_name));
+            if (!output.is_open()) {
+                throw std::runtime_error("Cannot open output file " + args::get(output_file_name));
+            }
+            write_json(output, corpus_identity, corpus, results);
+        }
+        else {
+            write_json(std::cout, corpus_identity, corpus, results);
+        }
+
+        if (baseline_file_name) {
+            switch (compare_with_baseline(args::get(baseline_file_name), corpus_identity, results, args::get(threshold))) {
+            case Comparison::PASSED:
+                break;
+            case Comparison::REGRESSED:
+                return 4;
+            case Comparison::SKIPPED:
+                return 5;
+            }
+        }
+    }
+    catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    }
+    catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (args::ValidationError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const std::invalid_argument & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return 3;
+    }
+
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include "decoder/header_probe.hpp"
+#include "utils/mapped_file.hpp"
+#include "utils/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Third-party:
+#include <args.hxx>
+#include <fmt/core.h>
+
+namespace {
+
+enum class Format
+{
+    JSON,
+    CSV,
+};
+
+inline static constexpr const char * CsvHeader =
+        "path,size,width,height,components,sampling,precision,progressive,arithmetic,restart_interval,quality,quantization_tables,error";
+
+Format parse_format(const std::string & name)
+{
+    if (name == "json") {
+        return Format::JSON;
+    }
+    if (name == "csv") {
+        return Format::CSV;
+    }
+    throw std::invalid_argument("Unknown format: " + name);
+}
+
+bool is_jpeg(const std::filesystem::path & path)
+{
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) { return std::tolower(c); });
+    return extension == ".jpg" || extension == ".jpeg";
+}
+
+/** Returns the JPEG files of the directory tree, or the file itself. */
+std::vector<std::filesystem::path> find_images(const std::filesystem::path & input)
+{
+    if (!std::filesystem::is_directory(input)) {
+        return {input};
+    }
+    std::vector<std::filesystem::path> paths;
+    const auto options = std::filesystem::directory_options::skip_permission_denied;
+    for (const auto & entry : std::filesystem::recursive_directory_iterator(input, options)) {
+        if (entry.is_regular_file() && is_jpeg(entry.path())) {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+std::string escape_json(const std::string & text)
+{
+    std::string result;
+    result.reserve(text.size() + 2);
+    for (const unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += static_cast<char>(c);
+        }
+        else if (c < 0x20) {
+            result += fmt::format("\\u{:04x}", c);
+        }
+        else {
+            result += static_cast<char>(c);
+        }
+    }
+    return result;
+}
+
+std::string escape_csv(const std::string & text)
+{
+    if (text.find_first_of(",\"\n\r") == std::string::npos) {
+        return text;
+    }
+    std::string result = "\"";
+    for (const auto c : text) {
+        if (c == '"') {
+            result += '"';
+        }
+        result += c;
+    }
+    return result + '"';
+}
+
+std::string join(const std::array<int, 64> & table, const char * separator)
+{
+    std::string result;
+    for (const auto step : table) {
+        if (!result.empty()) {
+            result += separator;
+        }
+        result += std::to_string(step);
+    }
+    return result;
+}
+
+/** Sampling factors of the components as HxV separated by spaces, e.g. "2x2 1x1 1x1". */
+std::string format_sampling(const HeaderProbe & header)
+{
+    std::string result;
+    for (const auto & component : header.m_components) {
+        if (!result.empty()) {
+            result += ' ';
+        }
+        result += fmt::format("{}x{}", component.m_horizontal_sampling, component.m_vertical_sampling);
+    }
+    return result;
+}
+
+std::string format_json(const std::string & path, const std::size_t size, const HeaderProbe & header)
+{
+    std::string tables;
+    for (const auto & [id, table] : header.m_quantization_tables) {
+        tables += fmt::format("{}\"{}\": [{}]", tables.empty() ? "" : ", ", id, join(table, ", "));
+    }
+    return fmt::format("{{\"path\": \"{}\", \"size\": {}, \"width\": {}, \"height\": {}, \"components\": {}, \"sampling\": \"{}\", "
+                       "\"precision\": {}, \"progressive\": {}, \"arithmetic\": {}, \"restart_interval\": {}, \"quality\": {}, "
+                       "\"quantization_tables\": {{{}}}}}\n",
+                       escape_json(path),
+                       size,
+                       header.m_width,
+                       header.m_height,
+                       header.m_components.size(),
+                       format_sampling(header),
+                       header.m_precision,
+                       header.is_progressive(),
+                       header.is_arithmetic(),
+                       header.m_restart_interval,
+                       header.estimate_quality(),
+                       tables);
+}
+
+/** The tables are written as id:steps separated by semicolons, the steps in zigzag order separated by spaces. */
+std::string format_csv(const std::string & path, const std::size_t size, const HeaderProbe & header)
+{
+    std::string tables;
+    for (const auto & [id, table] : header.m_quantization_tables) {
+        tables += fmt::format("{}{}:{}", tables.empty() ? "" : ";", id, join(table, " "));
+    }
+    return fmt::format("{},{},{},{},{},{},{},{},{},{},{},{},\n",
+                       escape_csv(path),
+                       size,
+                       header.m_width,
+                       header.m_height,
+                       header.m_components.size(),
+                       format_sampling(header),
+                       header.m_precision,
+                       header.is_progressive(),
+                       header.is_arithmetic(),
+                       header.m_restart_interval,
+                       header.estimate_quality(),
+                       tables);
+}
+
+std::string format_error(const Format format, const std::string & path, const std::size_t size, const std::string & error)
+{
+    if (format == Format::JSON) {
+        return fmt::format("{{\"path\": \"{}\", \"size\": {}, \"error\": \"{}\"}}\n", escape_json(path), size, escape_json(error));
+    }
+    return fmt::format("{},{},,,,,,,,,,,{}\n", escape_csv(path), size, escape_csv(error));
+}
+
+/**
+ * @brief Probes the file, the errors are reported in the line of the file.
+ *
+ * @return The line and whether it reports an error.
+ */
+std::pair<std::string, bool> describe(const std::filesystem::path & path, const Format format)
+{
+    const auto file_name = path.string();
+    std::size_t size = 0;
+    try {
+        const utils::MappedFile file(file_name);
+        size = file.size();
+        const auto header = HeaderProbe::probe(file.data(), file.size());
+        return {format == Format::JSON ? format_json(file_name, size, header) : format_csv(file_name, size, header), false};
+    }
+    catch (const std::exception & e) {
+        return {format_error(format, file_name, size, e.what()), true};
+    }
+}
+
+/**
+ * @brief Writes one line per image as soon as it is probed, so the order of
+ * the lines depends on the threads.
+ *
+ * @return The number of the images which could not be probed.
+ */
+std::size_t scan(const std::vector<std::filesystem::path> & paths, const Format format, const std::size_t threads_count, std::ostream & output)
+{
+    std::mutex output_mutex;
+    std::size_t errors_count = 0;
+    if (format == Format::CSV) {
+        output << CsvHeader << '\n';
+    }
+    utils::parallel_for(paths.size(), threads_count, [&](const std::size_t i) {
+        const auto [line, is_error] = describe(paths[i], format);
+        std::lock_guard<std::mutex> lock(output_mutex);
+        output << line;
+        errors_count += is_error;
+    });
+    output.flush();
+    return errors_count;
+}
+
+} // namespace
+
+int main(int argc, const char * argv[])
+{
+    args::ArgumentParser parser("Catalog of JPEG headers: dimensions, sampling, quantization tables and restart interval of every image");
+
+    args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+
+    args::ValueFlag<std::string> input(parser, "input", "The directory scanned recursively or a single JPEG file", {'i', "input"}, args::Options::Required);
+    args::ValueFlag<std::string> output_file_name(parser, "output_file_name", "The output file name, stdout by default", {'o', "output"});
+    args::ValueFlag<std::string> format_name(parser, "format", "The output format: json (JSON Lines) or csv", {'f', "format"}, "json");
+    args::ValueFlag<std::size_t> threads_count(parser, "threads", "The number of threads, 0 means all CPU cores", {'t', "threads"}, 0);
+
+    try {
+        parser.ParseCLI(argc, argv);
+
+        const auto format = parse_format(args::get(format_name));
+        const auto paths = find_images(args::get(input));
+
+        std::size_t errors_count = 0;
+        if (output_file_name) {
+            std::ofstream output(args::get(output_file_name));
+            if (!output.is_open()) {
+                throw std::runtime_error("Cannot open output file " + args::get(output_file_name));
+            }
+            errors_count = scan(paths, format, args::get(threads_count), output);
+        }
+        else {
+            errors_count = scan(paths, format, args::get(threads_count), std::cout);
+        }
+        if (errors_count > 0) {
+            std::cerr << fmt::format("{} of {} images could not be probed\n", errors_count, paths.size());
+        }
+    }
+    catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    }
+    catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (args::ValidationError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const std::invalid_argument & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return 3;
+    }
+
+    return 0;
+}
@@ -0,0 +1,346 @@
+#include "decoder/decoder.hpp"
+#include "encoder/encoder.hpp"
+#include "utils/image.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+// Third-party:
+#include <args.hxx>
+#include <fmt/core.h>
+
+namespace {
+
+/**
+ * @brief SplitMix64 generator. Unlike the distributions of the standard
+ * library it gives the same sequence on every platform.
+ */
+class Random
+{
+public:
+    explicit Random(const std::uint64_t seed)
+        : m_state(seed)
+    {
+    }
+
+    std::uint64_t next()
+    {
+        auto z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    /** Returns the number in [0, bound). */
+    std::size_t below(const std::size_t bound)
+    {
+        return static_cast<std::size_t>(next() % bound);
+    }
+
+    Byte byte()
+    {
+        return static_cast<Byte>(next() >> 56);
+    }
+
+private:
+    std::uint64_t m_state;
+};
+
+enum class Content
+{
+    NOISE,
+    FLAT,
+    GRADIENT,
+    TEXT,
+};
+
+inline static constexpr std::pair<Content, const char *> Contents[] = {
+        {Content::NOISE, "noise"},
+        {Content::FLAT, "flat"},
+        {Content::GRADIENT, "gradient"},
+        {Content::TEXT, "text"},
+};
+
+struct Size
+{
+    std::size_t m_width;
+    std::size_t m_height;
+};
+
+/** From one block to 50 MP, the odd sizes leave partial MCUs. */
+inline static constexpr Size Sizes[] = {
+        {8, 8},
+        {33, 17},
+        {256, 256},
+        {641, 479},
+        {1920, 1080},
+        {4000, 3000},
+        {8192, 6144},
+};
+
+inline static constexpr int Qualities[] = {95, 75, 50, 90, 30};
+
+inline static constexpr const char * Samplings[] = {"444", "420", "gray"};
+
+inline static constexpr std::size_t RestartIntervals[] = {0, 1, 7, 64};
+
+/**
+ * Incremented whenever the same parameters start to give other images, so
+ * the benchmark does not compare them with the baseline of the old ones.
+ */
+inline static constexpr int CorpusVersion = 2;
+
+struct Entry
+{
+    std::string m_name;
+    Content m_content;
+    Size m_size;
+    int m_quality;
+    std::string m_sampling;
+    std::size_t m_restart_interval;
+    std::uint64_t m_seed;
+};
+
+/**
+ * @brief Every content is generated in every size, the other parameters
+ * are cycled, so each of them meets every content and several sizes.
+ */
+std::vector<Entry> get_entries(const double max_megapixels, const std::uint64_t seed)
+{
+    std::vector<Entry> entries;
+    for (std::size_t i = 0; i < std::size(Sizes); ++i) {
+        const auto size = Sizes[i];
+        if (size.m_width * size.m_height > max_megapixels * 1e6) {
+            continue;
+        }
+        for (std::size_t j = 0; j < std::size(Contents); ++j) {
+            const auto k = i + j;
+            Entry entry{"",
+                        Contents[j].first,
+                        size,
+                        Qualities[k % std::size(Qualities)],
+                        Samplings[k % std::size(Samplings)],
+                        RestartIntervals[k % std::size(RestartIntervals)],
+                        seed * 1000 + i * std::size(Contents) + j};
+            entry.m_name = fmt::format("{}-{}x{}-q{}-{}-r{}",
+                                       Contents[j].second,
+                                       size.m_width,
+                                       size.m_height,
+                                       entry.m_quality,
+                                       entry.m_sampling,
+                                       entry.m_restart_interval);
+            entries.push_back(std::move(entry));
+        }
+    }
+    return entries;
+}
+
+void generate_noise(std::vector<char> & pixels, Random & random)
+{
+    for (auto & pixel : pixels) {
+        pixel = static_cast<char>(random.byte());
+    }
+}
+
+/** Flat rectangles of random colors, the borders are not aligned to blocks. */
+void generate_flat(std::vector<char> & pixels, const Size size, const std::size_t components_count, Random & random)
+{
+    static constexpr std::size_t Cells = 4;
+    std::array<std::size_t, Cells + 1> columns{0}, rows{0};
+    for (std::size_t i = 1; i < Cells; ++i) {
+        columns[i] = i * size.m_width / Cells + random.below(size.m_width / Cells / 2 + 1);
+        rows[i] = i * size.m_height / Cells + random.below(size.m_height / Cells / 2 + 1);
+    }
+    columns[Cells] = size.m_width;
+    rows[Cells] = size.m_height;
+
+    for (std::size_t cell_row = 0; cell_row < Cells; ++cell_row) {
+        for (std::size_t cell_column = 0; cell_column < Cells; ++cell_column) {
+            const std::array<Byte, 3> color{random.byte(), random.byte(), random.byte()};
+            for (auto row = rows[cell_row]; row < rows[cell_row + 1]; ++row) {
+                for (auto column = columns[cell_column]; column < columns[cell_column + 1]; ++column) {
+                    for (std::size_t c = 0; c < components_count; ++c) {
+                        pixels[(row * size.m_width + column) * components_count + c] = static_cast<char>(color[c]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/** Linear gradients with random directions for every component. */
+void generate_gradient(std::vector<char> & pixels, const Size size, const std::size_t components_count, Random & random)
+{
+    std::array<std::array<double, 3>, 3> gradients;
+    for (auto & gradient : gradients) {
+        gradient = {static_cast<double>(random.below(256)), random.below(512) / 256. - 1., random.below(512) / 256. - 1.};
+    }
+    const auto scale = 255. / std::max(size.m_width, size.m_height);
+    for (std::size_t row = 0; row < size.m_height; ++row) {
+        for (std::size_t column = 0; column < size.m_width; ++column) {
+            for (std::size_t c = 0; c < components_count; ++c) {
+                const auto & [offset, dx, dy] = gradients[c];
+                const auto value = std::abs(std::fmod(offset + (dx * column + dy * row) * scale, 510.));
+                pixels[(row * size.m_width + column) * components_count + c] = static_cast<char>(value > 255. ? 510. - value : value);
+            }
+        }
+    }
+}
+
+/** Lines of random 5x7 glyphs: sharp edges on the flat background. */
+void generate_text(std::vector<char> & pixels, const Size size, const std::size_t components_count, Random & random)
+{
+    std::fill(pixels.begin(), pixels.end(), static_cast<char>(245));
+    const auto scale = 1 + std::min(size.m_width, size.m_height) / 512;
+    const auto glyph_width = 6 * scale, line_height = 9 * scale;
+    for (std::size_t top = scale; top + 7 * scale <= size.m_height; top += line_height) {
+        for (std::size_t left = scale; left + 5 * scale <= size.m_width; left += glyph_width) {
+            const auto glyph = random.next();
+            if (glyph % 8 == 0) {
+                continue; // Space
+            }
+            for (std::size_t bit = 0; bit < 35; ++bit) {
+                if (((glyph >> (bit + 3)) & 1) == 0) {
+                    continue;
+                }
+                const auto glyph_row = top + bit / 5 * scale, glyph_column = left + bit % 5 * scale;
+                for (std::size_t row = glyph_row; row < glyph_row + scale; ++row) {
+                    std::fill_n(pixels.begin() + (row * size.m_width + glyph_column) * components_count, scale * components_count, static_cast<char>(16));
+                }
+            }
+        }
+    }
+}
+
+utils::Image generate(const Entry & entry)
+{
+    const auto components_count = entry.m_sampling == "gray" ? 1 : 3;
+    std::vector<char> pixels(entry.m_size.m_width * entry.m_size.m_height * components_count);
+    Random random(entry.m_seed);
+    switch (entry.m_content) {
+    case Content::NOISE:
+        generate_noise(pixels, random);
+        break;
+    case Content::FLAT:
+        generate_flat(pixels, entry.m_size, components_count, random);
+        break;
+    case Content::GRADIENT:
+        generate_gradient(pixels, entry.m_size, components_count, random);
+        break;
+    case Content::TEXT:
+        generate_text(pixels, entry.m_size, components_count, random);
+        break;
+    }
+    return {entry.m_size.m_width, entry.m_size.m_height, static_cast<std::size_t>(components_count), std::move(pixels)};
+}
+
+BytesList read_file(const std::string & file_name)
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening input file: " + file_name);
+    }
+    return {std::istreambuf_iterator<char>(file), {}};
+}
+
+/**
+ * @brief Writes the image decoded with zeroed out coefficients as
+ * the enhanced one, so the residual modes do not depend on the network.
+ */
+void write_enhanced(const std::string & jpeg_file_name, const std::string & ppm_file_name, const std::size_t power)
+{
+    auto decoder = std::make_unique<Decoder>();
+    decoder->toggle_mode(Decoder::Mode::ZERO_OUT_AND_DECODE).set_dct_filter(power);
+    decoder->decode(read_file(jpeg_file_name));
+
+    std::ofstream output(ppm_file_name, std::ios::binary);
+    if (!output.is_open()) {
+        throw std::runtime_error("Cannot open output file " + ppm_file_name);
+    }
+    output << "P" << (decoder->is_color_image() ? 6 : 5) << "\n"
+           << decoder->get_width() << " " << decoder->get_height() << "\n255\n";
+    output.write(reinterpret_cast<const char *>(decoder->get_image().data()), decoder->get_image_size());
+}
+
+} // namespace
+
+int main(int argc, const char * argv[])
+{
+    args::ArgumentParser parser("Deterministic synthetic JPEG corpus generator");
+
+    args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+
+    args::ValueFlag<std::string> output_directory(parser, "output_directory", "The directory for the corpus", {'o', "output"}, args::Options::Required);
+    args::ValueFlag<double> max_megapixels(parser, "max_megapixels", "Skip the sizes larger than this", {"max-megapixels"}, 50.5);
+    args::ValueFlag<std::uint64_t> seed(parser, "seed", "The seed of the content", {"seed"}, 1);
+    args::ValueFlag<std::size_t> power(parser, "power", "The power of the DCT coefficient filter of the enhanced images", {'p', "power"}, 16);
+
+    try {
+        parser.ParseCLI(argc, argv);
+
+        const std::filesystem::path directory = args::get(output_directory);
+        std::filesystem::create_directories(directory);
+
+        std::ofstream manifest(directory / "corpus.csv");
+        if (!manifest.is_open()) {
+            throw std::runtime_error("Cannot open output file " + (directory / "corpus.csv").string());
+        }
+        manifest << "name,content,width,height,quality,sampling,restart_interval\n";
+
+        // The identity of the corpus, the benchmark compares only the results measured on the same one
+        std::ofstream identity(directory / "corpus.json");
+        if (!identity.is_open()) {
+            throw std::runtime_error("Cannot open output file " + (directory / "corpus.json").string());
+        }
+        identity << fmt::format("{{\"generator\": \"CorpusGenerator\", \"version\": {}, \"seed\": {}, \"max_megapixels\": {}}}\n",
+                                CorpusVersion,
+                                args::get(seed),
+                                args::get(max_megapixels));
+
+        for (const auto & entry : get_entries(args::get(max_megapixels), args::get(seed))) {
+            const auto jpeg_file_name = (directory / (entry.m_name + ".jpg")).string();
+            Encoder::Options options;
+            options.m_quality = entry.m_quality;
+            options.m_subsample = entry.m_sampling == "420";
+            options.m_restart_interval = entry.m_restart_interval;
+            Encoder::encode(jpeg_file_name, generate(entry), options);
+            write_enhanced(jpeg_file_name, (directory / (entry.m_name + ".enhanced.ppm")).string(), args::get(power));
+
+            manifest << fmt::format("{},{},{},{},{},{},{}\n",
+                                    entry.m_name,
+                                    Contents[static_cast<std::size_t>(entry.m_content)].second,
+                                    entry.m_size.m_width,
+                                    entry.m_size.m_height,
+                                    entry.m_quality,
+                                    entry.m_sampling,
+                                    entry.m_restart_interval);
+            std::cerr << entry.m_name << std::endl;
+        }
+    }
+    catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    }
+    catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (args::ValidationError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
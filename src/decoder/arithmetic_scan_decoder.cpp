@@ -0,0 +1,240 @@
+/**
+ * @file arithmetic_scan_decoder.cpp
+ * @brief Arithmetic decoding of the sequential DCT scan (ITU T.81, Annex D
+ * and section F.2.4).
+ */
+
+#include "decoder/arithmetic_scan_decoder.hpp"
+
+#include "decoder/decoding_exception.hpp"
+
+#include <utility>
+
+
+namespace {
+
+/**
+ * @brief Packs Qe value, Next_Index_MPS, Switch_MPS and Next_Index_LPS of
+ * Table D.2 into one word.
+ */
+constexpr std::uint32_t pack(const std::uint32_t qe, const std::uint32_t next_lps, const std::uint32_t next_mps, const std::uint32_t switch_mps)
+{
+    return (qe << 16) | (next_mps << 8) | (switch_mps << 7) | next_lps;
+}
+
+// clang-format off
+
+/** Table D.2: Qe values and probability estimation state machine. */
+inline static constexpr std::uint32_t STATES[] = {
+    pack(0x5a1d,   1,   1, 1), pack(0x2586,  14,   2, 0), pack(0x1114,  16,   3, 0), pack(0x080b,  18,   4, 0),
+    pack(0x03d8,  20,   5, 0), pack(0x01da,  23,   6, 0), pack(0x00e5,  25,   7, 0), pack(0x006f,  28,   8, 0),
+    pack(0x0036,  30,   9, 0), pack(0x001a,  33,  10, 0), pack(0x000d,  35,  11, 0), pack(0x0006,   9,  12, 0),
+    pack(0x0003,  10,  13, 0), pack(0x0001,  12,  13, 0), pack(0x5a7f,  15,  15, 1), pack(0x3f25,  36,  16, 0),
+    pack(0x2cf2,  38,  17, 0), pack(0x207c,  39,  18, 0), pack(0x17b9,  40,  19, 0), pack(0x1182,  42,  20, 0),
+    pack(0x0cef,  43,  21, 0), pack(0x09a1,  45,  22, 0), pack(0x072f,  46,  23, 0), pack(0x055c,  48,  24, 0),
+    pack(0x0406,  49,  25, 0), pack(0x0303,  51,  26, 0), pack(0x0240,  52,  27, 0), pack(0x01b1,  54,  28, 0),
+    pack(0x0144,  56,  29, 0), pack(0x00f5,  57,  30, 0), pack(0x00b7,  59,  31, 0), pack(0x008a,  60,  32, 0),
+    pack(0x0068,  62,  33, 0), pack(0x004e,  63,  34, 0), pack(0x003b,  32,  35, 0), pack(0x002c,  33,   9, 0),
+    pack(0x5ae1,  37,  37, 1), pack(0x484c,  64,  38, 0), pack(0x3a0d,  65,  39, 0), pack(0x2ef1,  67,  40, 0),
+    pack(0x261f,  68,  41, 0), pack(0x1f33,  69,  42, 0), pack(0x19a8,  70,  43, 0), pack(0x1518,  72,  44, 0),
+    pack(0x1177,  73,  45, 0), pack(0x0e74,  74,  46, 0), pack(0x0bfb,  75,  47, 0), pack(0x09f8,  77,  48, 0),
+    pack(0x0861,  78,  49, 0), pack(0x0706,  79,  50, 0), pack(0x05cd,  48,  51, 0), pack(0x04de,  50,  52, 0),
+    pack(0x040f,  50,  53, 0), pack(0x0363,  51,  54, 0), pack(0x02d4,  52,  55, 0), pack(0x025c,  53,  56, 0),
+    pack(0x01f8,  54,  57, 0), pack(0x01a4,  55,  58, 0), pack(0x0160,  56,  59, 0), pack(0x0125,  57,  60, 0),
+    pack(0x00f6,  58,  61, 0), pack(0x00cb,  59,  62, 0), pack(0x00ab,  61,  63, 0), pack(0x008f,  61,  32, 0),
+    pack(0x5b12,  65,  65, 1), pack(0x4d04,  80,  66, 0), pack(0x412c,  81,  67, 0), pack(0x37d8,  82,  68, 0),
+    pack(0x2fe8,  83,  69, 0), pack(0x293c,  84,  70, 0), pack(0x2379,  86,  71, 0), pack(0x1edf,  87,  72, 0),
+    pack(0x1aa9,  87,  73, 0), pack(0x174e,  72,  74, 0), pack(0x1424,  72,  75, 0), pack(0x119c,  74,  76, 0),
+    pack(0x0f6b,  74,  77, 0), pack(0x0d51,  75,  78, 0), pack(0x0bb6,  77,  79, 0), pack(0x0a40,  77,  48, 0),
+    pack(0x5832,  80,  81, 1), pack(0x4d1c,  88,  82, 0), pack(0x438e,  89,  83, 0), pack(0x3bdd,  90,  84, 0),
+    pack(0x34ee,  91,  85, 0), pack(0x2eae,  92,  86, 0), pack(0x299a,  93,  87, 0), pack(0x2516,  86,  71, 0),
+    pack(0x5570,  88,  89, 1), pack(0x4ca9,  95,  90, 0), pack(0x44d9,  96,  91, 0), pack(0x3e22,  97,  92, 0),
+    pack(0x3824,  99,  93, 0), pack(0x32b4,  99,  94, 0), pack(0x2e17,  93,  86, 0), pack(0x56a8,  95,  96, 1),
+    pack(0x4f46, 101,  97, 0), pack(0x47e5, 102,  98, 0), pack(0x41cf, 103,  99, 0), pack(0x3c3d, 104, 100, 0),
+    pack(0x375e,  99,  93, 0), pack(0x5231, 105, 102, 0), pack(0x4c0f, 106, 103, 0), pack(0x4639, 107, 104, 0),
+    pack(0x415e, 103,  99, 0), pack(0x5627, 105, 106, 1), pack(0x50e7, 108, 107, 0), pack(0x4b85, 109, 103, 0),
+    pack(0x5597, 110, 109, 0), pack(0x504f, 111, 107, 0), pack(0x5a10, 110, 111, 1), pack(0x5522, 112, 109, 0),
+    pack(0x59eb, 112, 111, 1),
+    // Fixed probability 0.5, never changes
+    pack(0x5a1d, 113, 113, 0),
+};
+
+// clang-format on
+
+} // namespace
+
+ArithmeticScanDecoder::ArithmeticScanDecoder(std::function<Byte()> next_byte)
+    : m_next_byte(std::move(next_byte))
+{
+}
+
+void ArithmeticScanDecoder::set_dc_conditioning(const std::size_t table_id, const Byte lower, const Byte upper)
+{
+    if (table_id >= TablesCount || lower > upper || upper > 15) {
+        throw DecodingException("Invalid DC conditioning", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    m_dc_lower[table_id] = lower;
+    m_dc_upper[table_id] = upper;
+}
+
+void ArithmeticScanDecoder::set_ac_conditioning(const std::size_t table_id, const Byte threshold)
+{
+    if (table_id >= TablesCount || threshold < 1 || threshold > 63) {
+        throw DecodingException("Invalid AC conditioning", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    m_ac_threshold[table_id] = threshold;
+}
+
+void ArithmeticScanDecoder::reset(const std::size_t components_count)
+{
+    for (auto & statistics : m_dc_statistics) {
+        statistics.fill(0);
+    }
+    for (auto & statistics : m_ac_statistics) {
+        statistics.fill(0);
+    }
+    m_dc_contexts.assign(components_count, 0);
+    m_c = 0;
+    m_a = 0;
+    m_ct = -16; // Two initial bytes are read into C before decoding
+}
+
+int ArithmeticScanDecoder::decode(Byte & state)
+{
+    // Renormalization and data input (D.2.6)
+    while (m_a < 0x8000) {
+        if (--m_ct < 0) {
+            m_c = (m_c << 8) | m_next_byte();
+            if ((m_ct += 8) < 0 && ++m_ct == 0) {
+                m_a = 0x8000; // Both initial bytes are read
+            }
+        }
+        m_a <<= 1;
+    }
+
+    auto symbol = static_cast<int>(state);
+    auto qe = STATES[symbol & 0x7F];
+    const auto next_lps = static_cast<Byte>(qe & 0xFF);
+    qe >>= 8;
+    const auto next_mps = static_cast<Byte>(qe & 0xFF);
+    qe >>= 8;
+
+    // Decoding and estimation (D.2.4, D.2.5)
+    m_a -= qe;
+    const auto scaled_a = m_a << m_ct;
+    if (m_c >= scaled_a) {
+        m_c -= scaled_a;
+        // Conditional exchange of LPS
+        if (m_a < qe) {
+            m_a = qe;
+            state = (symbol & 0x80) ^ next_mps;
+        }
+        else {
+            m_a = qe;
+            state = (symbol & 0x80) ^ next_lps;
+            symbol ^= 0x80;
+        }
+    }
+    else if (m_a < 0x8000) {
+        // Conditional exchange of MPS
+        if (m_a < qe) {
+            state = (symbol & 0x80) ^ next_lps;
+            symbol ^= 0x80;
+        }
+        else {
+            state = (symbol & 0x80) ^ next_mps;
+        }
+    }
+    return symbol >> 7;
+}
+
+int ArithmeticScanDecoder::decode_magnitude(int magnitude, Byte * statistics)
+{
+    // Bit pattern of the magnitude below its leading bit (F.24)
+    int value = magnitude;
+    statistics += 14;
+    while (magnitude >>= 1) {
+        if (decode(*statistics)) {
+            value |= magnitude;
+        }
+    }
+    return value + 1;
+}
+
+int ArithmeticScanDecoder::decode_dc_difference(const std::size_t component_index, const std::size_t table_id)
+{
+    auto & context = m_dc_contexts[component_index];
+    auto * statistics = m_dc_statistics[table_id].data() + context;
+
+    if (decode(*statistics) == 0) {
+        context = 0;
+        return 0;
+    }
+    const auto sign = decode(statistics[1]);
+    statistics += 2 + sign;
+
+    // Magnitude category (F.23), its statistics start at X1 = 20 (Table F.4)
+    int magnitude = decode(*statistics);
+    if (magnitude != 0) {
+        statistics = m_dc_statistics[table_id].data() + 20;
+        while (decode(*statistics)) {
+            if ((magnitude <<= 1) == 0x8000) {
+                throw DecodingException("Arithmetic code magnitude overflow", DecodingException::Reason::SYNTAX_ERROR);
+            }
+            ++statistics;
+        }
+    }
+
+    // Conditioning category of the next difference (F.1.4.4.1.2)
+    if (magnitude < ((1 << m_dc_lower[table_id]) >> 1)) {
+        context = 0;
+    }
+    else if (magnitude > ((1 << m_dc_upper[table_id]) >> 1)) {
+        context = 12 + sign * 4;
+    }
+    else {
+        context = 4 + sign * 4;
+    }
+
+    const auto value = decode_magnitude(magnitude, statistics);
+    return sign ? -value : value;
+}
+
+void ArithmeticScanDecoder::decode_ac(std::array<int, 64> & block, const std::size_t table_id)
+{
+    auto * statistics_base = m_ac_statistics[table_id].data();
+    std::size_t k = 0;
+    do {
+        auto * statistics = statistics_base + 3 * k;
+        if (decode(*statistics)) {
+            break; // End of block
+        }
+        while (true) {
+            ++k;
+            if (decode(statistics[1])) {
+                break;
+            }
+            statistics += 3;
+            if (k >= 63) {
+                throw DecodingException("Arithmetic code spectral overflow", DecodingException::Reason::SYNTAX_ERROR);
+            }
+        }
+        const auto sign = decode(m_fixed_state);
+        statistics += 2;
+
+        // Magnitude category (F.23), the first decision is at X1 = SE + 2 (Table F.5)
+        int magnitude = decode(*statistics);
+        if (magnitude != 0 && decode(*statistics)) {
+            magnitude <<= 1;
+            statistics = statistics_base + (k <= m_ac_threshold[table_id] ? 189 : 217);
+            while (decode(*statistics)) {
+                if ((magnitude <<= 1) == 0x8000) {
+                    throw DecodingException("Arithmetic code magnitude overflow", DecodingException::Reason::SYNTAX_ERROR);
+                }
+                ++statistics;
+            }
+        }
+        const auto value = decode_magnitude(magnitude, statistics);
+        block[k] = sign ? -value : value;
+    } while (k < 63);
+}
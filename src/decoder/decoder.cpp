@@ -8,7 +8,27 @@
 #include "decoder/decoder.hpp"
 
 #include "decoder/decoding_exception.hpp"
+#include "encoder/constants.hpp"
 #include "utils/discrete_cosine_transform.hpp"
+#include "utils/kernels.hpp"
+#include "utils/parallel.hpp"
+
+#include <cmath>
+#include <thread>
+
+namespace {
+
+/** Returns the steps of the table read from DQT in the order of the segment. */
+Bytes<64> get_zigzag_steps(const utils::QuantizationTable & table)
+{
+    Bytes<64> steps;
+    for (std::size_t k = 0; k < 64; ++k) {
+        steps[k] = table.get()[utils::ZIGZAG_ORDER[k]];
+    }
+    return steps;
+}
+
+} // namespace
 
 Decoder & Decoder::set_dct_filter(const std::size_t dct_filter_power)
 {
@@ -16,6 +36,18 @@ Decoder & Decoder::set_dct_filter(const std::size_t dct_filter_power)
     return *this;
 }
 
+Decoder & Decoder::set_adaptive_dct_filter(const bool is_adaptive)
+{
+    m_is_adaptive_dct_filter = is_adaptive;
+    return *this;
+}
+
+Decoder & Decoder::set_arithmetic_residuals(const bool is_arithmetic)
+{
+    m_is_arithmetic_output = is_arithmetic;
+    return *this;
+}
+
 Decoder & Decoder::toggle_mode(const Mode & mode)
 {
     m_mode = mode;
@@ -28,6 +60,81 @@ Decoder & Decoder::set_enhanced_file(const std::string & enhanced_file_name)
     return *this;
 }
 
+Decoder & Decoder::set_enhanced_image(utils::Image enhanced_image)
+{
+    m_enhanced_file = std::move(enhanced_image);
+    return *this;
+}
+
+Decoder & Decoder::set_enhancer(Enhancer enhancer)
+{
+    m_enhancer = std::move(enhancer);
+    return *this;
+}
+
+Decoder & Decoder::set_lossless_transform(LosslessTransform transform)
+{
+    m_lossless_transform = std::move(transform);
+    return *this;
+}
+
+Decoder & Decoder::set_requantization_quality(const std::size_t quality)
+{
+    m_requantization_quality = quality;
+    return *this;
+}
+
+Decoder & Decoder::set_chroma_subsampling(const bool is_subsampling)
+{
+    m_is_chroma_subsampling = is_subsampling;
+    return *this;
+}
+
+Decoder & Decoder::set_scan_index_interval(const std::size_t rows_per_entry)
+{
+    m_scan_index_interval = rows_per_entry;
+    return *this;
+}
+
+Decoder & Decoder::set_scan_index(ScanIndex scan_index)
+{
+    m_scan_index = std::move(scan_index);
+    return *this;
+}
+
+Decoder & Decoder::set_threads_count(const std::size_t threads_count)
+{
+    m_threads_count = threads_count;
+    return *this;
+}
+
+Decoder & Decoder::set_region(const std::size_t first_row, const std::size_t rows_count)
+{
+    if (rows_count == 0) {
+        throw std::invalid_argument("Region must not be empty");
+    }
+    m_region = Region{first_row, rows_count};
+    return *this;
+}
+
+Decoder & Decoder::set_planar_output(const bool is_planar)
+{
+    m_is_planar_output = is_planar;
+    return *this;
+}
+
+Decoder & Decoder::set_luma_only(const bool is_luma_only)
+{
+    m_is_luma_only = is_luma_only;
+    return *this;
+}
+
+Decoder & Decoder::set_error_resilience(const bool is_resilient)
+{
+    m_is_error_resilient = is_resilient;
+    return *this;
+}
+
 unsigned char Decoder::clip(const int x)
 {
     if (x < 0) {
@@ -64,6 +171,41 @@ bool Decoder::IsResidualsProcessing() const
     return IsEncodeResidualsMode() || IsDecodeResidualsMode();
 }
 
+bool Decoder::IsTranscodeMode() const
+{
+    return m_mode == Mode::TRANSCODE;
+}
+
+bool Decoder::IsTransdecodeMode() const
+{
+    return m_mode == Mode::TRANSDECODE;
+}
+
+bool Decoder::IsTranscoding() const
+{
+    return IsTranscodeMode() || IsTransdecodeMode();
+}
+
+bool Decoder::IsTransformMode() const
+{
+    return m_mode == Mode::TRANSFORM;
+}
+
+bool Decoder::IsZeroingOut() const
+{
+    return IsZeroOutAndDecodeMode() || IsTranscoding();
+}
+
+bool Decoder::IsWritingOutput() const
+{
+    return IsResidualsProcessing() || IsTranscoding();
+}
+
+bool Decoder::IsWritingArithmeticResiduals() const
+{
+    return m_is_arithmetic_output && (IsEncodeResidualsMode() || IsTranscodeMode());
+}
+
 unsigned char Decoder::get_bytes(const std::size_t count)
 {
     if (m_size < count) {
@@ -72,7 +214,7 @@ unsigned char Decoder::get_bytes(const std::size_t count)
     const auto * begin = m_position;
     m_position += count;
     m_size -= count;
-    if (IsResidualsProcessing() && !m_is_scanning) {
+    if (IsWritingOutput() && !m_is_scanning && !m_is_output_suppressed) {
         for (auto * byte = begin; byte != m_position != 0; ++byte) {
             m_output << *byte;
         }
@@ -110,6 +252,12 @@ int Decoder::read_bits(const std::size_t bits)
                 else {
                     m_buffer = (m_buffer << 8) | marker;
                     m_bits_in_buffer += 8;
+                    if (m_buffered_restart_marker == nullptr) {
+                        m_buffered_restart_marker = m_position;
+                    }
+                    else {
+                        m_is_restart_marker_overrun = true;
+                    }
                 }
             }
         }
@@ -170,6 +318,23 @@ void Decoder::skip_marker()
     skip(m_length);
 }
 
+Byte Decoder::read_marker()
+{
+    const auto marker = m_position[1];
+    const bool is_rewritten = IsWritingOutput() && (marker == 0xC9 || marker == 0xCC || (marker == 0xDA && m_is_arithmetic_frame));
+    m_is_output_suppressed = is_rewritten;
+    skip(2);
+    m_is_output_suppressed = false;
+    if (is_rewritten && marker == 0xC9) {
+        m_output << 0xFF << 0xC0;
+    }
+    if (is_rewritten && marker == 0xDA) {
+        write_standard_huffman_tables();
+        m_output << 0xFF << 0xDA;
+    }
+    return marker;
+}
+
 bool Decoder::is_point_of_two(const std::size_t x)
 {
     return x != 0 && (x & (x - 1)) == 0;
@@ -216,13 +381,16 @@ void Decoder::decode_start_of_frame()
         c.m_width = (m_width * c.m_sampling.m_y + m_sampling.m_y - 1) / m_sampling.m_y;
         c.m_height = (m_height * c.m_sampling.m_x + m_sampling.m_x - 1) / m_sampling.m_x;
         c.m_stride = blocks_shape.m_width * c.m_sampling.m_y << 3;
+        if (IsTransformMode() || (m_is_luma_only && &c != &m_components.front())) {
+            continue; // The component is not decoded into pixels
+        }
         if (((c.m_width < 3) && (c.m_sampling.m_y != m_sampling.m_y)) ||
             ((c.m_height < 3) && (c.m_sampling.m_x != m_sampling.m_x)))
             throw DecodingException("Unsupported image format", DecodingException::Reason::UNSUPPORTED);
-        c.m_pixels = BytesList(c.m_stride * blocks_shape.m_height * c.m_sampling.m_x << 3);
+        c.m_pixels = utils::Plane(c.m_stride * blocks_shape.m_height * c.m_sampling.m_x << 3, m_arena);
     }
-    if (components_count == 3) {
-        m_rgb = BytesList(m_width * m_height * components_count);
+    if (components_count == 3 && !m_is_luma_only && !IsTransformMode()) {
+        m_rgb = utils::Plane(m_width * m_height * components_count, m_arena);
     }
 
     skip(m_length);
@@ -268,7 +436,7 @@ void Decoder::decode_huffman_tables()
             throw DecodingException("Unsupported image format", DecodingException::Reason::UNSUPPORTED);
         }
         i = (i | (i >> 3)) & 3; // combined DC/AC + tableid value
-        static Bytes<17> counts;
+        Bytes<17> counts{};
         int total_codes_count = 0;
         for (int code_length = 1; code_length <= 16; ++code_length) {
             const auto count = m_position[code_length];
@@ -367,6 +535,54 @@ void Decoder::decode_dri()
     skip(m_length);
 }
 
+void Decoder::decode_arithmetic_conditioning()
+{
+    // DAC is not copied to the output: the output is coded with Huffman code
+    m_is_output_suppressed = true;
+    decode_length();
+    if (m_length % 2 != 0) {
+        throw DecodingException("Syntax error", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    while (m_length > 0) {
+        if ((m_position[0] >> 4) > 1) {
+            throw DecodingException("Syntax error", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        m_arithmetic_conditioning.emplace_back(m_position[0], m_position[1]);
+        skip(2);
+    }
+    m_is_output_suppressed = false;
+}
+
+void Decoder::write_standard_huffman_tables()
+{
+    BytesList segment{0x01, 0xA2}; // Lenght (418)
+    const auto append = [&segment](const Byte table_class, const auto & spectrum, const auto & values) {
+        segment.push_back(table_class);
+        segment.insert(segment.end(), spectrum.begin(), spectrum.end());
+        segment.insert(segment.end(), values.begin(), values.end());
+    };
+    append(0x00, constants::luminance::dc::SPECTRUM, constants::luminance::dc::VALUES);
+    append(0x10, constants::luminance::ac::SPECTRUM, constants::luminance::ac::VALUES);
+    append(0x01, constants::chrominance::dc::SPECTRUM, constants::chrominance::dc::VALUES);
+    append(0x11, constants::chrominance::ac::SPECTRUM, constants::chrominance::ac::VALUES);
+
+    m_output << 0xFF << 0xC4;
+    for (const auto byte : segment) {
+        m_output << byte;
+    }
+
+    // The tables are parsed as if they were in the input
+    const auto * position = m_position;
+    const auto size = m_size;
+    m_position = segment.data();
+    m_size = segment.size();
+    m_is_output_suppressed = true;
+    decode_huffman_tables();
+    m_is_output_suppressed = false;
+    m_position = position;
+    m_size = size;
+}
+
 Decoder::HuffmanDecodingResult Decoder::decode_huffman(HuffmanCodeEntry huffman_table[], const std::size_t index, const utils::Mask & mask)
 {
     HuffmanDecodingResult result;
@@ -409,11 +625,69 @@ Decoder::HuffmanDecodingResult Decoder::decode_huffman(HuffmanCodeEntry huffman_
 
 void Decoder::decode_block(Component & component, unsigned char * output, utils::DCTCoefficientsFilter & filter, const std::optional<std::array<int, 64>> optional_enhanced_block)
 {
-    const auto mask = !IsDefaultMode() && component.m_id == 1 ? filter.get_mask() : utils::MaskAll;
+    const auto last_dc = component.m_last_dc;
+    const auto block_start = get_scan_bits_position();
+
+    const auto is_filtered = !IsDefaultMode() && !IsTransformMode() && component.m_id == 1;
+    const utils::MaskEntry * mask_entry = nullptr;
+    const auto get_mask = [&](const std::array<int, 64> & head) -> const utils::Mask & {
+        if (mask_entry == nullptr) {
+            mask_entry = is_filtered ? &filter.get_entry(head) : &utils::KeepAllEntry;
+        }
+        return mask_entry->m_mask;
+    };
+
+    auto block = decode_coefficients(component, get_mask);
+
+    get_mask(block);
+    const auto & mask = *mask_entry;
+    if (is_filtered) {
+        auto & statistics = m_block_class_statistics[static_cast<std::size_t>(utils::DCTCoefficientsFilter::classify(block))];
+        ++statistics.m_blocks_count;
+        statistics.m_input_bits += get_scan_bits_position() - block_start;
+    }
+
+    if (IsResidualsProcessing()) {
+        encode_residuals(component, block, mask, optional_enhanced_block, last_dc);
+        return;
+    }
+    if (IsTransformMode()) {
+        m_retained_blocks.push_back(block);
+        return;
+    }
+    if (IsTranscoding()) {
+        m_retained_blocks.push_back(block);
+    }
+    decode_pixels(component, block, mask, output);
+}
+
+std::array<int, 64> Decoder::decode_coefficients(Component & component, const utils::ArithmeticCode::MaskProvider & mask_provider)
+{
+    if (m_arithmetic_decoder.has_value()) {
+        auto block = component.m_arithmetic_code.decode(component.m_last_dc, mask_provider, *m_arithmetic_decoder);
+        component.m_last_dc = block[0];
+        return block;
+    }
 
     std::array<int, 64> block;
     block.fill(0);
 
+    if (m_arithmetic_scan_decoder.has_value()) {
+        const auto component_index = static_cast<std::size_t>(&component - m_components.data());
+        block[0] = component.m_last_dc + m_arithmetic_scan_decoder->decode_dc_difference(component_index, component.m_dc_huffman_table_id);
+        m_arithmetic_scan_decoder->decode_ac(block, component.m_ac_huffman_table_id & 1);
+        if (component.m_id == 1) {
+            m_dct_coefficients_distribution[0].push_back(block[0]);
+            for (std::size_t i = 1; i < 64; ++i) {
+                if (block[i] != 0) {
+                    m_dct_coefficients_distribution[i].push_back(block[i]);
+                }
+            }
+        }
+        component.m_last_dc = block[0];
+        return block;
+    }
+
     // Decode DC
     auto * dc_huffman_table = m_huffman_tables[component.m_dc_huffman_table_id];
     const auto dc = decode_huffman(dc_huffman_table);
@@ -439,52 +713,100 @@ void Decoder::decode_block(Component & component, unsigned char * output, utils:
                                     DecodingException::Reason::SYNTAX_ERROR);
         }
 
-        if (IsResidualsProcessing()) {
-            block[i] = ac.m_coefficient;
-        }
-        else {
-            block[utils::REVERSED_ZIGZAG_ORDER[i]] = ac.m_coefficient;
-        }
+        block[i] = ac.m_coefficient;
 
         if (component.m_id == 1) {
             m_dct_coefficients_distribution[i].push_back(ac.m_coefficient);
         }
     }
 
-    if (IsResidualsProcessing()) {
-        if (optional_enhanced_block.has_value()) {
-            if (component.m_id != 1) {
-                throw DecodingException("Enhanced block provided for Cr/Cb component",
-                                        DecodingException::Reason::INTERNAL_ERROR);
-            }
-            const auto & enhanced_block = optional_enhanced_block.value();
-            for (std::size_t i = 1; i < 64; ++i) {
-                if (mask[i]) {
-                    continue;
-                }
-                if (IsEncodeResidualsMode()) {
-                    block[i] -= enhanced_block[i];
-                }
-                else {
-                    block[i] += enhanced_block[i];
-                }
-            }
+    component.m_last_dc = block[0];
+    return block;
+}
+
+void Decoder::skip_block(Component & component)
+{
+    if (m_arithmetic_scan_decoder.has_value()) {
+        // The contexts of the arithmetic decoder depend on the decoded values
+        decode_coefficients(component, [](const std::array<int, 64> &) -> const utils::Mask & { return utils::MaskAll; });
+        return;
+    }
+
+    // Only the lengths of the code words and of the values are needed
+    const auto skip_code = [this](const HuffmanCodeEntry huffman_table[]) {
+        const auto entry = huffman_table[read_bits(16)];
+        if (entry.m_length == 0) {
+            throw DecodingException("A codeword in the Huffman code cannot have a length of 0",
+                                    DecodingException::Reason::SYNTAX_ERROR);
+        }
+        skip_bits(entry.m_length);
+        skip_bits(entry.m_decoded_value & 0b1111);
+        return entry.m_decoded_value;
+    };
+
+    skip_code(m_huffman_tables[component.m_dc_huffman_table_id]);
+    const auto * ac_huffman_table = m_huffman_tables[component.m_ac_huffman_table_id];
+    for (std::size_t i = 1; i < 64; ++i) {
+        const auto decoded_value = skip_code(ac_huffman_table);
+        if (decoded_value == 0) {
+            break; // End of block
+        }
+        i += decoded_value >> 4;
+        if (i > 63) {
+            throw DecodingException(fmt::format("Run goes beyond the boundaries of the block: {}", i),
+                                    DecodingException::Reason::SYNTAX_ERROR);
         }
-        component.m_huffman_code.encode(block, component.m_last_dc, m_output);
     }
-    else {
-        if (IsZeroOutAndDecodeMode()) {
-            for (std::size_t i = 0; i < block.size(); ++i) {
-                if (!mask[i]) {
-                    block[i] = 0;
-                }
+}
+
+void Decoder::encode_residuals(Component & component,
+                               std::array<int, 64> & block,
+                               const utils::MaskEntry & mask,
+                               const std::optional<std::array<int, 64>> & optional_enhanced_block,
+                               const int last_dc)
+{
+    if (optional_enhanced_block.has_value()) {
+        if (component.m_id != 1) {
+            throw DecodingException("Enhanced block provided for Cr/Cb component",
+                                    DecodingException::Reason::INTERNAL_ERROR);
+        }
+        const auto & enhanced_block = optional_enhanced_block.value();
+        const auto block_start = m_output.get_bits_count();
+        const auto block_class = utils::DCTCoefficientsFilter::classify(block);
+        for (const auto i : mask.m_zeroed_positions) {
+            if (i == 0) {
+                continue;
+            }
+            if (IsEncodeResidualsMode() || IsTranscodeMode()) {
+                block[i] -= enhanced_block[i];
+            }
+            else {
+                block[i] += enhanced_block[i];
             }
         }
-        m_quantization_tables.at(component.m_quantization_table_id).inverse(block);
-        utils::DiscreteCosineTransform::inverse(block, component.m_stride, output);
+        write_block(component, block, last_dc, mask);
+        m_block_class_statistics[static_cast<std::size_t>(block_class)].m_output_bits += m_output.get_bits_count() - block_start;
+        return;
     }
+    write_block(component, block, last_dc, mask);
+}
 
-    component.m_last_dc += dc.m_coefficient;
+void Decoder::decode_pixels(const Component & component, const std::array<int, 64> & block, const utils::MaskEntry & mask, unsigned char * output)
+{
+    // The mask is applied to the zigzag positions, the same ones which store
+    // the residuals, so the zeroed out image does not depend on whether
+    // the block holds the original coefficients or the residuals.
+    std::array<int, 64> coefficients;
+    for (std::size_t i = 0; i < block.size(); ++i) {
+        coefficients[utils::REVERSED_ZIGZAG_ORDER[i]] = block[i];
+    }
+    if (IsZeroingOut()) {
+        for (const auto i : mask.m_zeroed_positions) {
+            coefficients[utils::REVERSED_ZIGZAG_ORDER[i]] = 0;
+        }
+    }
+    m_quantization_tables.at(component.m_quantization_table_id).inverse(coefficients);
+    utils::DiscreteCosineTransform::inverse(coefficients, component.m_stride, output);
 }
 
 std::size_t Decoder::get_blocks_count(const std::size_t size, std::size_t sampling)
@@ -495,7 +817,7 @@ std::size_t Decoder::get_blocks_count(const std::size_t size, std::size_t sampli
 
 std::optional<std::array<int, 64>> Decoder::get_enhanced_coefficients(const Component & component, const std::size_t x, const std::size_t y)
 {
-    if (!IsResidualsProcessing() || component.m_id != 1) {
+    if (!(IsResidualsProcessing() || IsTranscoding()) || component.m_id != 1) {
         return std::nullopt;
     }
     std::array<float, 64> image_fragment;
@@ -510,7 +832,6 @@ std::optional<std::array<int, 64>> Decoder::get_enhanced_coefficients(const Comp
 
 void Decoder::decode_start_of_scan()
 {
-    int rst_count = m_rst_interval, next_rst = 0;
     decode_length();
     if (m_length < (4 + 2 * m_components.size()))
         throw DecodingException("Syntax error", DecodingException::Reason::SYNTAX_ERROR);
@@ -534,165 +855,992 @@ void Decoder::decode_start_of_scan()
         throw DecodingException("Unsupported image format", DecodingException::Reason::UNSUPPORTED);
     }
     skip(m_length);
+    if (IsResidualsProcessing()) {
+        verify_enhanced_image();
+    }
     m_is_scanning = true;
     m_output.reset();
+    if (IsWritingArithmeticResiduals()) {
+        m_arithmetic_encoder.emplace(m_output);
+    }
+    if (m_is_arithmetic_input) {
+        if (!IsDecodeResidualsMode() && !IsTransdecodeMode()) {
+            throw DecodingException("Arithmetic coded residuals can only be transdecoded", DecodingException::Reason::UNSUPPORTED);
+        }
+        m_arithmetic_decoder.emplace([this]() { return read_arithmetic_byte(); });
+    }
+    if (m_is_arithmetic_frame) {
+        if (m_scan_index_interval != 0 || m_scan_index.has_value()) {
+            throw DecodingException("Scan index is not supported for arithmetic coded images", DecodingException::Reason::UNSUPPORTED);
+        }
+        m_arithmetic_scan_decoder.emplace([this]() { return read_arithmetic_byte(); });
+        for (const auto & [table, value] : m_arithmetic_conditioning) {
+            if (table >> 4) {
+                m_arithmetic_scan_decoder->set_ac_conditioning(table & 0x0F, value);
+            }
+            else {
+                m_arithmetic_scan_decoder->set_dc_conditioning(table & 0x0F, value & 0x0F, value >> 4);
+            }
+        }
+        m_arithmetic_scan_decoder->reset(m_components.size());
+    }
 
-    const auto x_blocks_count = get_blocks_count(m_height, m_sampling.m_x);
-    const auto y_blocks_count = get_blocks_count(m_width, m_sampling.m_y);
+    m_scan_start = m_position;
+    m_scan_size = m_size;
 
-    utils::DCTCoefficientsFilter filter(m_dct_filter_power);
-    for (std::size_t global_block_x = 0; global_block_x < x_blocks_count; ++global_block_x) {
-        for (std::size_t global_block_y = 0; global_block_y < y_blocks_count; ++global_block_y) {
-            for (auto & component : m_components) {
-                for (std::size_t block_x = 0; block_x < component.m_sampling.m_x; ++block_x) {
-                    for (std::size_t block_y = 0; block_y < component.m_sampling.m_y; ++block_y) {
-                        const auto x = (global_block_x * component.m_sampling.m_x + block_x) * 8;
-                        const auto y = (global_block_y * component.m_sampling.m_y + block_y) * 8;
+    if (IsTransformMode()) {
+        std::size_t mcu_blocks_count = 0;
+        for (const auto & component : m_components) {
+            mcu_blocks_count += component.m_sampling.m_x * component.m_sampling.m_y;
+        }
+        m_retained_blocks.reserve(get_blocks_count(m_height, m_sampling.m_x) * get_blocks_count(m_width, m_sampling.m_y) * mcu_blocks_count);
+    }
 
-                        auto * out = &component.m_pixels[x * component.m_stride + y];
+    if (m_region.has_value()) {
+        if (!IsDefaultMode() && !IsZeroOutAndDecodeMode()) {
+            throw DecodingException("Region decoding is supported only when decoding pixels", DecodingException::Reason::UNSUPPORTED);
+        }
+        if (m_region->m_first_row + m_region->m_rows_count > m_height) {
+            throw DecodingException(fmt::format("Region is out of the image of height {}", m_height),
+                                    DecodingException::Reason::UNSUPPORTED);
+        }
+    }
 
-                        decode_block(component, out, filter, get_enhanced_coefficients(component, x, y));
-                    }
-                }
-            }
-            if (m_rst_interval > 0 && --rst_count == 0) {
-                byte_align();
-                const auto i = get_bits(16);
-                if (((i & 0xFFF8) != 0xFFD0) || ((i & 7) != next_rst)) {
-                    throw DecodingException("Invalid RST", DecodingException::Reason::SYNTAX_ERROR);
-                }
-                next_rst = (next_rst + 1) & 7;
-                rst_count = m_rst_interval;
-                for (auto & component : m_components) {
-                    component.m_last_dc = 0;
-                }
-            }
+    if (m_is_error_resilient) {
+        if (!IsDefaultMode() && !IsZeroOutAndDecodeMode()) {
+            throw DecodingException("Error resilient decoding is supported only when decoding pixels", DecodingException::Reason::UNSUPPORTED);
+        }
+        if (m_is_arithmetic_frame || m_scan_index_interval != 0) {
+            throw DecodingException("Error resilient decoding is not supported for arithmetic coded images and the scan index",
+                                    DecodingException::Reason::UNSUPPORTED);
+        }
+    }
+
+    if (m_is_luma_only) {
+        if (!IsDefaultMode() && !IsZeroOutAndDecodeMode()) {
+            throw DecodingException("Luma-only decoding is supported only when decoding pixels", DecodingException::Reason::UNSUPPORTED);
+        }
+        if (m_components.front().m_sampling.m_x != m_sampling.m_x || m_components.front().m_sampling.m_y != m_sampling.m_y) {
+            throw DecodingException("Luma-only decoding requires the luma at the full resolution", DecodingException::Reason::UNSUPPORTED);
+        }
+    }
+
+    const auto [first_row, last_row] = get_rows_to_decode();
+    if (can_use_scan_index()) {
+        decode_indexed_rows(first_row, last_row);
+    }
+    else {
+        if (m_scan_index_interval != 0) {
+            m_scan_index = ScanIndex{};
+            m_scan_index->m_rows_per_entry = m_scan_index_interval;
+            m_scan_index->m_scan_size = m_scan_size;
         }
+        int rst_count = m_rst_interval, next_rst = 0;
+        auto filter = get_dct_filter();
+        decode_mcu_rows(0, last_row, filter, rst_count, next_rst, get_planes());
     }
 
     if (IsResidualsProcessing()) {
-        m_output.write(0b1111111, 7) // Do the bit alignment of the EOI marker
-                << 0xFF << 0xD9;
+        write_end_of_image();
     }
 
     m_decoding_finished = true;
 }
 
-#define CF4A (-9)
-#define CF4B (111)
-#define CF4C (29)
-#define CF4D (-3)
-#define CF3A (28)
-#define CF3B (109)
-#define CF3C (-9)
-#define CF3X (104)
-#define CF3Y (27)
-#define CF3Z (-3)
-#define CF2A (139)
-#define CF2B (-11)
-#define CF(x) clip(((x) + 64) >> 7)
+std::size_t Decoder::get_scan_bits_position() const
+{
+    return (m_scan_size - m_size) * 8 - m_bits_in_buffer;
+}
 
-void Decoder::horizontal_upsample(Component & component)
+void Decoder::write_arithmetic_segment()
 {
-    const int xmax = component.m_width - 3;
-    unsigned char *lin, *lout;
-    BytesList out((component.m_width * component.m_height) << 1);
-    lin = component.m_pixels.data();
-    lout = out.data();
-    for (int y = component.m_height; y; --y) {
-        lout[0] = CF(CF2A * lin[0] + CF2B * lin[1]);
-        lout[1] = CF(CF3X * lin[0] + CF3Y * lin[1] + CF3Z * lin[2]);
-        lout[2] = CF(CF3A * lin[0] + CF3B * lin[1] + CF3C * lin[2]);
-        for (int x = 0; x < xmax; ++x) {
-            lout[(x << 1) + 3] =
-                    CF(CF4A * lin[x] + CF4B * lin[x + 1] + CF4C * lin[x + 2] + CF4D * lin[x + 3]);
-            lout[(x << 1) + 4] =
-                    CF(CF4D * lin[x] + CF4C * lin[x + 1] + CF4B * lin[x + 2] + CF4A * lin[x + 3]);
-        }
-        lin += component.m_stride;
-        lout += component.m_width << 1;
-        lout[-3] = CF(CF3A * lin[-1] + CF3B * lin[-2] + CF3C * lin[-3]);
-        lout[-2] = CF(CF3X * lin[-1] + CF3Y * lin[-2] + CF3Z * lin[-3]);
-        lout[-1] = CF(CF2A * lin[-1] + CF2B * lin[-2]);
-    }
-    component.m_width <<= 1;
-    component.m_stride = component.m_width;
-    component.m_pixels = out;
+    m_output << 0xFF << utils::ArithmeticCode::SegmentMarker << 0x00 << static_cast<Byte>(2 + utils::ArithmeticCode::Signature.size())
+             << utils::ArithmeticCode::Signature;
 }
 
-void Decoder::vertical_upsample(Component & c)
+bool Decoder::decode_arithmetic_segment()
 {
-    const int w = c.m_width, s1 = c.m_stride, s2 = s1 + s1;
-    unsigned char *cin, *cout;
-    int x, y;
-    BytesList out((c.m_width * c.m_height) << 1);
-    for (x = 0; x < w; ++x) {
-        cin = &c.m_pixels[x];
-        cout = &out[x];
-        *cout = CF(CF2A * cin[0] + CF2B * cin[s1]);
-        cout += w;
-        *cout = CF(CF3X * cin[0] + CF3Y * cin[s1] + CF3Z * cin[s2]);
-        cout += w;
-        *cout = CF(CF3A * cin[0] + CF3B * cin[s1] + CF3C * cin[s2]);
-        cout += w;
-        cin += s1;
-        for (y = c.m_height - 3; y; --y) {
-            *cout = CF(CF4A * cin[-s1] + CF4B * cin[0] + CF4C * cin[s1] + CF4D * cin[s2]);
-            cout += w;
-            *cout = CF(CF4D * cin[-s1] + CF4C * cin[0] + CF4B * cin[s1] + CF4A * cin[s2]);
-            cout += w;
-            cin += s1;
-        }
-        cin += s1;
-        *cout = CF(CF3A * cin[0] + CF3B * cin[-s1] + CF3C * cin[-s2]);
-        cout += w;
-        *cout = CF(CF3X * cin[0] + CF3Y * cin[-s1] + CF3Z * cin[-s2]);
-        cout += w;
-        *cout = CF(CF2A * cin[0] + CF2B * cin[-s1]);
+    const auto & signature = utils::ArithmeticCode::Signature;
+    const auto segment_size = 4 + signature.size();
+    if (m_size < segment_size || m_position[1] != utils::ArithmeticCode::SegmentMarker ||
+        decode_16(m_position + 2) != 2 + signature.size() ||
+        !std::equal(signature.begin(), signature.end(), m_position + 4)) {
+        return false;
     }
-    c.m_height <<= 1;
-    c.m_stride = c.m_width;
-    c.m_pixels = out;
+    // The segment is not copied to the output: the transdecoded image is coded with Huffman code.
+    m_position += segment_size;
+    m_size -= segment_size;
+    m_is_arithmetic_input = true;
+    return true;
 }
 
-void Decoder::convert()
+Byte Decoder::read_arithmetic_byte()
 {
-    for (auto & component : m_components) {
-        while ((component.m_width < m_width) || (component.m_height < m_height)) {
-            if (component.m_width < m_width)
-                horizontal_upsample(component);
-            if (component.m_height < m_height)
-                vertical_upsample(component);
-        }
-        if (component.m_width < m_width || component.m_height < m_height) {
-            throw DecodingException("Internal application error occured", DecodingException::Reason::INTERNAL_ERROR);
-        }
+    if (m_size == 0 || (m_position[0] == 0xFF && (m_size < 2 || m_position[1] != 0x00))) {
+        return 0; // The marker after the scan
     }
-
-    if (m_components.size() == 3) {
-        // convert to RGB
-        auto * prgb = m_rgb.data();
-        const auto * py = m_components[0].m_pixels.data();
-        const auto * pcb = m_components[1].m_pixels.data();
-        const auto * pcr = m_components[2].m_pixels.data();
-        for (int y = m_height; y; --y) {
-            for (std::size_t x = 0; x < m_width; ++x) {
-                const auto y = py[x] << 8;
-                const auto cb = pcb[x] - 128;
-                const auto cr = pcr[x] - 128;
-                *prgb++ = clip((y + 359 * cr + 128) >> 8);
-                *prgb++ = clip((y - 88 * cb - 183 * cr + 128) >> 8);
-                *prgb++ = clip((y + 454 * cb + 128) >> 8);
-            }
-            py += m_components[0].m_stride;
-            pcb += m_components[1].m_stride;
-            pcr += m_components[2].m_stride;
-        }
-        return;
+    const auto byte = get_bytes();
+    if (byte == 0xFF) {
+        get_bytes(); // Skip the stuffed zero byte
     }
+    return byte;
+}
 
-    auto & component = m_components[0];
-    if (component.m_width == component.m_stride) {
+void Decoder::read_arithmetic_restart(const int next_rst)
+{
+    // The arithmetic decoder may not consume the last bytes of the interval
+    while (m_size >= 2 && (m_position[0] != 0xFF || m_position[1] == 0x00 || m_position[1] == 0xFF)) {
+        get_bytes();
+    }
+    if (m_size < 2 || m_position[1] != (0xD0 | next_rst)) {
+        throw DecodingException("Invalid RST", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    get_bytes(2);
+    m_arithmetic_scan_decoder->reset(m_components.size());
+}
+
+void Decoder::write_block(Component & component, const std::array<int, 64> & block, const int last_dc, const utils::MaskEntry & mask)
+{
+    if (m_arithmetic_encoder.has_value()) {
+        component.m_arithmetic_code.encode(block, last_dc, mask.m_mask, *m_arithmetic_encoder);
+    }
+    else {
+        component.m_huffman_code.encode(block, last_dc, m_output);
+    }
+}
+
+void Decoder::write_restart_marker(const int rst_number)
+{
+    // The arithmetic coded residuals have no RST markers
+    if (!m_arithmetic_encoder.has_value()) {
+        m_output.align() << 0xFF << static_cast<Byte>(0xD0 | rst_number);
+    }
+}
+
+void Decoder::write_end_of_image()
+{
+    if (m_arithmetic_encoder.has_value()) {
+        m_arithmetic_encoder->finish();
+        m_output << 0xFF << 0xD9;
+        return;
+    }
+    m_output.write(0b1111111, 7) // Do the bit alignment of the EOI marker
+            << 0xFF << 0xD9;
+}
+
+void Decoder::decode_scan_index_segment()
+{
+    decode_length();
+    if (!m_scan_index.has_value() && ScanIndex::is_scan_index(m_position, m_length)) {
+        m_scan_index = ScanIndex::from_bytes(m_position, m_length);
+    }
+    skip(m_length);
+}
+
+std::vector<unsigned char *> Decoder::get_planes()
+{
+    std::vector<unsigned char *> planes;
+    for (auto & component : m_components) {
+        planes.push_back(component.m_pixels.data());
+    }
+    return planes;
+}
+
+std::size_t Decoder::get_luma_blocks_per_row() const
+{
+    const auto y_blocks_count = get_blocks_count(m_width, m_sampling.m_y);
+    for (const auto & component : m_components) {
+        if (component.m_id == 1) {
+            return y_blocks_count * component.m_sampling.m_x * component.m_sampling.m_y;
+        }
+    }
+    return 0;
+}
+
+std::pair<std::size_t, std::size_t> Decoder::get_rows_to_decode() const
+{
+    const auto rows_count = get_blocks_count(m_height, m_sampling.m_x);
+    if (!m_region.has_value() || m_scan_index_interval != 0) {
+        return {0, rows_count};
+    }
+    // One more MCU row on each side keeps the chroma upsampling of the region
+    // the same as in the whole image.
+    const auto mcu_height = m_sampling.m_x << 3;
+    const auto first_row = m_region->m_first_row / mcu_height;
+    const auto last_row = (m_region->m_first_row + m_region->m_rows_count + mcu_height - 1) / mcu_height;
+    return {first_row > 0 ? first_row - 1 : 0, std::min(last_row + 1, rows_count)};
+}
+
+void Decoder::decode_mcu_rows(const std::size_t first_row,
+                              const std::size_t last_row,
+                              utils::DCTCoefficientsFilter & filter,
+                              int & rst_count,
+                              int & next_rst,
+                              const std::vector<unsigned char *> & planes)
+{
+    const auto y_blocks_count = get_blocks_count(m_width, m_sampling.m_y);
+    const auto x_blocks_count = get_blocks_count(m_height, m_sampling.m_x);
+
+    // The state of the error resilient mode: the MCUs left to fill and their DC coefficients,
+    // the first MCU of the restart interval and the DC coefficients before it
+    std::size_t lost_mcus_count = 0;
+    std::vector<int> lost_dc_values;
+    std::size_t interval_first_mcu = first_row * y_blocks_count;
+    std::vector<int> interval_dc_values;
+    const auto get_dc_values = [this] {
+        std::vector<int> dc_values;
+        for (const auto & component : m_components) {
+            dc_values.push_back(component.m_last_dc);
+        }
+        return dc_values;
+    };
+    if (m_is_error_resilient) {
+        interval_dc_values = get_dc_values();
+    }
+    const auto lose_mcus = [&](const std::size_t first_mcu, const int rst_count_left, const int expected_rst, std::vector<int> dc_values) {
+        lost_dc_values = std::move(dc_values);
+        lost_mcus_count = resynchronize(rst_count_left, expected_rst, last_row * y_blocks_count - first_mcu);
+        add_damaged_range(first_mcu, lost_mcus_count);
+    };
+    // The corrupt data may be found only after some MCUs of the interval are decoded from it
+    const auto lose_decoded_mcus = [&](const std::size_t end_mcu) {
+        for (auto mcu = interval_first_mcu; mcu < end_mcu; ++mcu) {
+            fill_damaged_mcu(mcu / y_blocks_count, mcu % y_blocks_count, interval_dc_values, planes);
+        }
+        add_damaged_range(interval_first_mcu, end_mcu - interval_first_mcu);
+    };
+
+    for (std::size_t global_block_x = first_row; global_block_x < last_row; ++global_block_x) {
+        if (m_scan_index_interval != 0 && global_block_x % m_scan_index_interval == 0) {
+            record_scan_index_entry(global_block_x, rst_count, next_rst);
+        }
+        for (std::size_t global_block_y = 0; global_block_y < y_blocks_count; ++global_block_y) {
+            const auto mcu = global_block_x * y_blocks_count + global_block_y;
+            if (lost_mcus_count == 0) {
+                try {
+                    for (std::size_t i = 0; i < m_components.size(); ++i) {
+                        auto & component = m_components[i];
+                        for (std::size_t block_x = 0; block_x < component.m_sampling.m_x; ++block_x) {
+                            for (std::size_t block_y = 0; block_y < component.m_sampling.m_y; ++block_y) {
+                                if (m_is_luma_only && i != 0) {
+                                    skip_block(component);
+                                    continue;
+                                }
+                                const auto x = (global_block_x * component.m_sampling.m_x + block_x) * 8;
+                                const auto y = (global_block_y * component.m_sampling.m_y + block_y) * 8;
+
+                                auto * out = planes[i] != nullptr ? planes[i] + x * component.m_stride + y : nullptr;
+
+                                decode_block(component, out, filter, IsTranscoding() ? std::nullopt : get_enhanced_coefficients(component, x, y));
+                            }
+                        }
+                    }
+                }
+                catch (const DecodingException & e) {
+                    if (!m_is_error_resilient || e.get_reason() != DecodingException::Reason::SYNTAX_ERROR) {
+                        throw;
+                    }
+                    if (m_rst_interval > 0) {
+                        lose_decoded_mcus(mcu);
+                        lose_mcus(mcu, rst_count, next_rst, interval_dc_values);
+                    }
+                    else {
+                        lose_mcus(mcu, 0, next_rst, get_dc_values());
+                    }
+                }
+            }
+            if (lost_mcus_count > 0) {
+                fill_damaged_mcu(global_block_x, global_block_y, lost_dc_values, planes);
+                --lost_mcus_count;
+                // The RST markers of the lost intervals are already skipped
+                if (m_rst_interval > 0 && --rst_count == 0) {
+                    next_rst = (next_rst + 1) & 7;
+                    rst_count = m_rst_interval;
+                    interval_first_mcu = mcu + 1;
+                    for (auto & component : m_components) {
+                        component.m_last_dc = 0;
+                    }
+                }
+                continue;
+            }
+            const bool is_last_mcu = global_block_x + 1 == x_blocks_count && global_block_y + 1 == y_blocks_count;
+            // There is no RST marker after the last MCU of the scan
+            if (m_rst_interval > 0 && --rst_count == 0 && !is_last_mcu) {
+                // The arithmetic coded residuals have no RST markers, only the DC predictors are reset
+                if (m_arithmetic_scan_decoder.has_value()) {
+                    read_arithmetic_restart(next_rst);
+                }
+                else if (!m_arithmetic_decoder.has_value()) {
+                    switch (read_restart_marker(next_rst)) {
+                    case RestartMarker::FOUND:
+                        if (m_is_error_resilient) {
+                            interval_dc_values = get_dc_values();
+                        }
+                        break;
+                    case RestartMarker::OVERRUN:
+                        lose_decoded_mcus(mcu + 1);
+                        break;
+                    case RestartMarker::MISSING:
+                        // Even a marker with a wrong number in place of the expected one
+                        // may follow the misplaced data, so the interval is not trusted
+                        lose_decoded_mcus(mcu + 1);
+                        lose_mcus(mcu + 1, 0, next_rst, interval_dc_values);
+                        break;
+                    }
+                }
+                if (IsResidualsProcessing()) {
+                    write_restart_marker(next_rst);
+                }
+                next_rst = (next_rst + 1) & 7;
+                rst_count = m_rst_interval;
+                interval_first_mcu = mcu + 1;
+                for (auto & component : m_components) {
+                    component.m_last_dc = 0;
+                }
+            }
+        }
+    }
+}
+
+Decoder::RestartMarker Decoder::read_restart_marker(const int next_rst)
+{
+    byte_align();
+    try {
+        const auto marker = get_bits(16);
+        if (marker == 0xFFD0 + next_rst) {
+            const bool is_overrun = m_is_restart_marker_overrun;
+            m_buffered_restart_marker = nullptr;
+            m_is_restart_marker_overrun = false;
+            return is_overrun && m_is_error_resilient ? RestartMarker::OVERRUN : RestartMarker::FOUND;
+        }
+        if (!m_is_error_resilient) {
+            throw DecodingException("Invalid RST", DecodingException::Reason::SYNTAX_ERROR);
+        }
+    }
+    catch (const DecodingException &) {
+        if (!m_is_error_resilient) {
+            throw;
+        }
+    }
+    return RestartMarker::MISSING;
+}
+
+std::size_t Decoder::resynchronize(const int rst_count, const int next_rst, const std::size_t mcus_left)
+{
+    // The damaged data may have read the marker into the bit buffer already
+    const auto * position = m_buffered_restart_marker != nullptr ? m_buffered_restart_marker - 2 : m_position;
+    const auto * end = m_scan_start + m_scan_size;
+    m_buffered_restart_marker = nullptr;
+    m_is_restart_marker_overrun = false;
+    m_buffer = 0;
+    m_bits_in_buffer = 0;
+
+    const auto is_marker = [this](const unsigned char * p) {
+        return p[0] == 0xFF && (p[1] == 0xD9 || (m_rst_interval > 0 && (p[1] & 0xF8) == 0xD0));
+    };
+    // As in libjpeg, only the expected marker and the next two ones are trusted. A marker behind
+    // the expected one or far ahead of it is more likely damaged data, so the search goes on.
+    std::size_t skipped_intervals = 0;
+    for (;; position += 2) {
+        while (position + 1 < end && !is_marker(position)) {
+            ++position;
+        }
+        if (position + 1 >= end || position[1] == 0xD9) {
+            m_position = end;
+            m_size = 0;
+            return mcus_left;
+        }
+        skipped_intervals = (position[1] - next_rst) & 7;
+        if (skipped_intervals <= 2) {
+            break;
+        }
+    }
+    m_position = position + 2;
+    m_size = end - m_position;
+    return std::min(rst_count + skipped_intervals * m_rst_interval, mcus_left);
+}
+
+void Decoder::fill_damaged_mcu(const std::size_t global_block_x,
+                               const std::size_t global_block_y,
+                               const std::vector<int> & dc_values,
+                               const std::vector<unsigned char *> & planes)
+{
+    for (std::size_t i = 0; i < m_components.size(); ++i) {
+        if (planes[i] == nullptr) {
+            continue;
+        }
+        const auto & component = m_components[i];
+        std::array<int, 64> block{};
+        block[0] = dc_values[i];
+        for (std::size_t block_x = 0; block_x < component.m_sampling.m_x; ++block_x) {
+            for (std::size_t block_y = 0; block_y < component.m_sampling.m_y; ++block_y) {
+                const auto x = (global_block_x * component.m_sampling.m_x + block_x) * 8;
+                const auto y = (global_block_y * component.m_sampling.m_y + block_y) * 8;
+                decode_pixels(component, block, utils::KeepAllEntry, planes[i] + x * component.m_stride + y);
+            }
+        }
+    }
+}
+
+void Decoder::add_damaged_range(const std::size_t first_mcu, const std::size_t mcus_count)
+{
+    if (mcus_count == 0) {
+        return;
+    }
+    if (!m_damaged_ranges.empty() && m_damaged_ranges.back().m_first_mcu + m_damaged_ranges.back().m_mcus_count == first_mcu) {
+        m_damaged_ranges.back().m_mcus_count += mcus_count;
+        return;
+    }
+    m_damaged_ranges.push_back({first_mcu, mcus_count});
+}
+
+void Decoder::record_scan_index_entry(const std::size_t mcu_row, const int rst_count, const int next_rst)
+{
+    ScanIndex::Entry entry;
+    entry.m_mcu_row = mcu_row;
+    entry.m_offset = m_position - m_scan_start;
+    entry.m_bits_count = m_bits_in_buffer;
+    entry.m_bits = m_buffer & ((std::size_t{1} << m_bits_in_buffer) - 1);
+    entry.m_rst_count = rst_count;
+    entry.m_next_rst = next_rst;
+    for (const auto & component : m_components) {
+        entry.m_dc_predictors.push_back(component.m_last_dc);
+    }
+    m_scan_index->m_entries.push_back(std::move(entry));
+}
+
+bool Decoder::can_use_scan_index() const
+{
+    // The error resilient mode decodes the whole scan sequentially
+    if (!m_scan_index.has_value() || m_scan_index_interval != 0 || !(IsDefaultMode() || IsZeroOutAndDecodeMode()) || m_is_error_resilient) {
+        return false;
+    }
+    if (m_scan_index->m_scan_size != m_scan_size) {
+        throw DecodingException("Scan index does not match the image", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    return true;
+}
+
+void Decoder::decode_indexed_rows(const std::size_t first_row, const std::size_t last_row)
+{
+    const auto rows_count = get_blocks_count(m_height, m_sampling.m_x);
+    const auto & entries = m_scan_index->m_entries;
+
+    // Bands between the consecutive entries covering the rows.
+    std::vector<std::pair<const ScanIndex::Entry *, std::size_t>> bands;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const auto band_first_row = entries[i].m_mcu_row;
+        const auto band_last_row = i + 1 < entries.size() ? entries[i + 1].m_mcu_row : rows_count;
+        if (band_first_row >= band_last_row || band_last_row > rows_count) {
+            throw DecodingException("Invalid scan index", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        if (band_first_row < last_row && band_last_row > first_row) {
+            bands.emplace_back(&entries[i], std::min(band_last_row, last_row));
+        }
+    }
+
+    const auto threads_count = std::min<std::size_t>(
+            bands.size(),
+            m_threads_count != 0 ? m_threads_count : std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::unique_ptr<Decoder>> band_decoders;
+    for (std::size_t i = 0; i < threads_count; ++i) {
+        band_decoders.push_back(make_band_decoder());
+    }
+
+    // Each thread decodes every threads_count-th band with its own decoder
+    // writing directly into the planes of this one.
+    const auto planes = get_planes();
+    utils::parallel_for(threads_count, threads_count, [&](const std::size_t thread) {
+        for (std::size_t i = thread; i < bands.size(); i += threads_count) {
+            band_decoders[thread]->decode_band(*bands[i].first, bands[i].second, planes);
+        }
+    });
+
+    for (const auto & band_decoder : band_decoders) {
+        for (std::size_t i = 0; i < utils::BlockClassesCount; ++i) {
+            m_block_class_statistics[i].m_blocks_count += band_decoder->m_block_class_statistics[i].m_blocks_count;
+            m_block_class_statistics[i].m_input_bits += band_decoder->m_block_class_statistics[i].m_input_bits;
+        }
+        for (std::size_t i = 0; i < m_dct_coefficients_distribution.size(); ++i) {
+            const auto & distribution = band_decoder->m_dct_coefficients_distribution[i];
+            m_dct_coefficients_distribution[i].insert(m_dct_coefficients_distribution[i].end(), distribution.begin(), distribution.end());
+        }
+    }
+}
+
+std::unique_ptr<Decoder> Decoder::make_band_decoder()
+{
+    auto band_decoder = std::make_unique<Decoder>();
+    band_decoder->m_mode = m_mode;
+    band_decoder->m_width = m_width;
+    band_decoder->m_height = m_height;
+    band_decoder->m_sampling = m_sampling;
+    band_decoder->m_quantization_tables = m_quantization_tables;
+    std::copy_n(&m_huffman_tables[0][0], std::size(m_huffman_tables) * std::size(m_huffman_tables[0]), &band_decoder->m_huffman_tables[0][0]);
+    band_decoder->m_rst_interval = m_rst_interval;
+    band_decoder->m_dct_filter_power = m_dct_filter_power;
+    band_decoder->m_is_adaptive_dct_filter = m_is_adaptive_dct_filter;
+    band_decoder->m_is_luma_only = m_is_luma_only;
+    band_decoder->m_is_scanning = true;
+    band_decoder->m_scan_start = m_scan_start;
+    band_decoder->m_scan_size = m_scan_size;
+    for (auto & component : m_components) {
+        // The band decoder writes into the planes of this decoder.
+        band_decoder->m_components.push_back(component);
+        band_decoder->m_components.back().m_pixels = {};
+    }
+    return band_decoder;
+}
+
+void Decoder::decode_band(const ScanIndex::Entry & entry, const std::size_t last_row, const std::vector<unsigned char *> & planes)
+{
+    if (entry.m_offset > m_scan_size || entry.m_bits_count >= 8 * sizeof(std::size_t) ||
+        entry.m_dc_predictors.size() != m_components.size()) {
+        throw DecodingException("Invalid scan index", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    m_position = m_scan_start + entry.m_offset;
+    m_size = m_scan_size - entry.m_offset;
+    m_buffer = entry.m_bits;
+    m_bits_in_buffer = entry.m_bits_count;
+    for (std::size_t i = 0; i < m_components.size(); ++i) {
+        m_components[i].m_last_dc = entry.m_dc_predictors[i];
+    }
+
+    int rst_count = entry.m_rst_count, next_rst = entry.m_next_rst;
+    auto filter = get_dct_filter();
+    filter.seek(entry.m_mcu_row * get_luma_blocks_per_row());
+    decode_mcu_rows(entry.m_mcu_row, last_row, filter, rst_count, next_rst, planes);
+}
+
+void Decoder::crop_to_region()
+{
+    const auto mcu_height = m_sampling.m_x << 3;
+    const auto [first_row, last_row] = get_rows_to_decode();
+    const auto top = first_row * mcu_height;
+    const auto bottom = std::min(last_row * mcu_height, m_height);
+    for (auto & c : m_components) {
+        const auto component_top = top * c.m_sampling.m_x / m_sampling.m_x;
+        const auto component_bottom = (bottom * c.m_sampling.m_x + m_sampling.m_x - 1) / m_sampling.m_x;
+        c.m_pixels.erase_front(component_top * c.m_stride);
+        c.m_height = component_bottom - component_top;
+    }
+    m_height = bottom - top;
+    m_region_offset = m_region->m_first_row - top;
+}
+
+void Decoder::finish_region()
+{
+    auto & image = m_components.size() == 1 ? m_components.front().m_pixels : m_rgb;
+    image.erase_front(m_region_offset * m_width * m_components.size());
+    m_height = m_region->m_rows_count;
+}
+
+void Decoder::finish_planar_region()
+{
+    for (auto & c : m_components) {
+        const auto top = m_region_offset * c.m_sampling.m_x / m_sampling.m_x;
+        const auto bottom = ((m_region_offset + m_region->m_rows_count) * c.m_sampling.m_x + m_sampling.m_x - 1) / m_sampling.m_x;
+        c.m_pixels.erase_front(top * c.m_stride);
+        c.m_height = std::min(bottom, c.m_height) - top;
+    }
+    m_height = m_region->m_rows_count;
+}
+
+void Decoder::verify_enhanced_image() const
+{
+    if (!m_enhanced_file.has_value()) {
+        throw DecodingException("Enhanced image is not set", DecodingException::Reason::INTERNAL_ERROR);
+    }
+    if (m_enhanced_file->get_width() != m_width || m_enhanced_file->get_height() != m_height) {
+        throw DecodingException(fmt::format("Enhanced image size {}x{} differs from the decoded one {}x{}",
+                                            m_enhanced_file->get_width(),
+                                            m_enhanced_file->get_height(),
+                                            m_width,
+                                            m_height),
+                                DecodingException::Reason::INTERNAL_ERROR);
+    }
+}
+
+utils::Image Decoder::get_decoded_image() const
+{
+    const auto & image = get_image();
+    std::vector<char> data(image.begin(), image.begin() + get_image_size());
+    return {m_width, m_height, m_components.size(), std::move(data)};
+}
+
+void Decoder::encode_retained_residuals()
+{
+    if (!m_enhancer) {
+        throw DecodingException("Enhancer is not set", DecodingException::Reason::INTERNAL_ERROR);
+    }
+    m_enhanced_file = m_enhancer(get_decoded_image());
+    verify_enhanced_image();
+
+    for (auto & component : m_components) {
+        component.m_last_dc = 0;
+    }
+
+    const auto x_blocks_count = get_blocks_count(m_height, m_sampling.m_x);
+    const auto y_blocks_count = get_blocks_count(m_width, m_sampling.m_y);
+
+    // Replays the scan of decode_start_of_scan() over the retained blocks.
+    int rst_count = m_rst_interval, next_rst = 0;
+    auto block = m_retained_blocks.begin();
+    auto filter = get_dct_filter();
+    for (std::size_t global_block_x = 0; global_block_x < x_blocks_count; ++global_block_x) {
+        for (std::size_t global_block_y = 0; global_block_y < y_blocks_count; ++global_block_y) {
+            for (auto & component : m_components) {
+                for (std::size_t block_x = 0; block_x < component.m_sampling.m_x; ++block_x) {
+                    for (std::size_t block_y = 0; block_y < component.m_sampling.m_y; ++block_y) {
+                        const auto x = (global_block_x * component.m_sampling.m_x + block_x) * 8;
+                        const auto y = (global_block_y * component.m_sampling.m_y + block_y) * 8;
+
+                        const auto & mask = component.m_id == 1 ? filter.get_entry(*block) : utils::KeepAllEntry;
+                        const auto last_dc = component.m_last_dc;
+                        component.m_last_dc = (*block)[0];
+                        encode_residuals(component, *block++, mask, get_enhanced_coefficients(component, x, y), last_dc);
+                    }
+                }
+            }
+            const bool is_last_mcu = global_block_x + 1 == x_blocks_count && global_block_y + 1 == y_blocks_count;
+            if (m_rst_interval > 0 && --rst_count == 0 && !is_last_mcu) {
+                write_restart_marker(next_rst);
+                next_rst = (next_rst + 1) & 7;
+                rst_count = m_rst_interval;
+                for (auto & component : m_components) {
+                    component.m_last_dc = 0;
+                }
+            }
+        }
+    }
+    m_retained_blocks.clear();
+
+    write_end_of_image();
+}
+
+void Decoder::write_transformed_image()
+{
+    const auto & transform = m_lossless_transform;
+    const auto x_blocks_count = get_blocks_count(m_height, m_sampling.m_x);
+    const auto y_blocks_count = get_blocks_count(m_width, m_sampling.m_y);
+
+    // The steps of the coefficients are divided by the steps of the new tables
+    std::vector<std::optional<std::pair<Bytes<64>, Bytes<64>>>> requantization_steps(m_components.size());
+    if (m_requantization_quality.has_value()) {
+        const auto original_tables = requantize_tables();
+        for (std::size_t i = 0; i < m_components.size(); ++i) {
+            const auto table_id = m_components[i].m_quantization_table_id;
+            requantization_steps[i].emplace(original_tables.at(table_id), get_zigzag_steps(m_quantization_tables.at(table_id)));
+        }
+    }
+
+    // Places the retained blocks of the scan in the grids of the components
+    std::vector<LosslessTransform::Blocks> blocks(m_components.size());
+    for (std::size_t i = 0; i < m_components.size(); ++i) {
+        blocks[i].m_width = y_blocks_count * m_components[i].m_sampling.m_y;
+        blocks[i].m_height = x_blocks_count * m_components[i].m_sampling.m_x;
+        blocks[i].m_blocks.resize(blocks[i].m_width * blocks[i].m_height);
+    }
+    auto block = m_retained_blocks.begin();
+    for (std::size_t global_block_x = 0; global_block_x < x_blocks_count; ++global_block_x) {
+        for (std::size_t global_block_y = 0; global_block_y < y_blocks_count; ++global_block_y) {
+            for (std::size_t i = 0; i < m_components.size(); ++i) {
+                const auto & sampling = m_components[i].m_sampling;
+                for (std::size_t block_x = 0; block_x < sampling.m_x; ++block_x) {
+                    for (std::size_t block_y = 0; block_y < sampling.m_y; ++block_y) {
+                        auto & to = blocks[i].at(global_block_y * sampling.m_y + block_y, global_block_x * sampling.m_x + block_x);
+                        for (std::size_t k = 0; k < 64; ++k) {
+                            auto coefficient = (*block)[k];
+                            if (requantization_steps[i].has_value()) {
+                                const int original_step = requantization_steps[i]->first[k], step = requantization_steps[i]->second[k];
+                                coefficient = (coefficient * original_step + (coefficient < 0 ? -step : step) / 2) / step;
+                            }
+                            to[utils::REVERSED_ZIGZAG_ORDER[k]] = coefficient;
+                        }
+                        ++block;
+                    }
+                }
+            }
+        }
+    }
+    m_retained_blocks.clear();
+
+    if (m_is_chroma_subsampling) {
+        subsample_chroma(blocks);
+    }
+
+    // The partial MCUs which would move to the left or to the top edge are dropped
+    if (transform.is_mirroring_columns()) {
+        m_width -= m_width % (m_sampling.m_y << 3);
+    }
+    if (transform.is_mirroring_rows()) {
+        m_height -= m_height % (m_sampling.m_x << 3);
+    }
+    if (m_width == 0 || m_height == 0) {
+        throw DecodingException("The mirrored side of the image is smaller than MCU", DecodingException::Reason::UNSUPPORTED);
+    }
+    for (std::size_t i = 0; i < m_components.size(); ++i) {
+        auto & sampling = m_components[i].m_sampling;
+        blocks[i] = transform.transform(blocks[i],
+                                        transform.is_mirroring_columns() ? get_blocks_count(m_width, m_sampling.m_y) * sampling.m_y : blocks[i].m_width,
+                                        transform.is_mirroring_rows() ? get_blocks_count(m_height, m_sampling.m_x) * sampling.m_x : blocks[i].m_height);
+        if (transform.is_transposing()) {
+            std::swap(sampling.m_x, sampling.m_y);
+        }
+    }
+    if (transform.is_transposing()) {
+        std::swap(m_width, m_height);
+        std::swap(m_sampling.m_x, m_sampling.m_y);
+    }
+
+    if (transform.m_crop.has_value()) {
+        const auto & crop = *transform.m_crop;
+        if (crop.m_x >= m_width || crop.m_y >= m_height) {
+            throw DecodingException(fmt::format("Crop region is out of the image of size {}x{}", m_width, m_height),
+                                    DecodingException::Reason::UNSUPPORTED);
+        }
+        // The region is extended to the left and to the top up to the MCU boundary
+        const auto left = crop.m_x / (m_sampling.m_y << 3);
+        const auto top = crop.m_y / (m_sampling.m_x << 3);
+        m_width = std::min(crop.m_x + crop.m_width, m_width) - left * (m_sampling.m_y << 3);
+        m_height = std::min(crop.m_y + crop.m_height, m_height) - top * (m_sampling.m_x << 3);
+        for (std::size_t i = 0; i < m_components.size(); ++i) {
+            const auto & sampling = m_components[i].m_sampling;
+            blocks[i] = LosslessTransform::crop(blocks[i],
+                                                left * sampling.m_y,
+                                                top * sampling.m_x,
+                                                get_blocks_count(m_width, m_sampling.m_y) * sampling.m_y,
+                                                get_blocks_count(m_height, m_sampling.m_x) * sampling.m_x);
+        }
+    }
+
+    m_output << 0xFF << 0xD8;
+    for (const auto & [id, table] : m_quantization_tables) {
+        m_output << 0xFF << 0xDB << 0x00 << 67 << static_cast<Byte>(id) << transform.transform_quantization_table(get_zigzag_steps(table));
+    }
+
+    const auto components_count = m_components.size();
+    m_output << 0xFF << 0xC0 << 0x00 << static_cast<Byte>(8 + 3 * components_count) << 8
+             << static_cast<Byte>(m_height >> 8) << static_cast<Byte>(m_height)
+             << static_cast<Byte>(m_width >> 8) << static_cast<Byte>(m_width)
+             << static_cast<Byte>(components_count);
+    for (const auto & component : m_components) {
+        m_output << static_cast<Byte>(component.m_id)
+                 << static_cast<Byte>((component.m_sampling.m_y << 4) | component.m_sampling.m_x)
+                 << static_cast<Byte>(component.m_quantization_table_id);
+    }
+
+    // The transposed blocks and the new DC differences may have no code
+    // words in the original tables
+    write_standard_huffman_tables();
+    if (m_rst_interval > 0) {
+        m_output << 0xFF << 0xDD << 0x00 << 0x04 << static_cast<Byte>(m_rst_interval >> 8) << static_cast<Byte>(m_rst_interval);
+    }
+
+    m_output << 0xFF << 0xDA << 0x00 << static_cast<Byte>(6 + 2 * components_count) << static_cast<Byte>(components_count);
+    for (std::size_t i = 0; i < components_count; ++i) {
+        auto & component = m_components[i];
+        const auto table_id = i == 0 ? 0 : 1;
+        m_output << static_cast<Byte>(component.m_id) << static_cast<Byte>(table_id << 4 | table_id);
+        component.m_huffman_code = utils::HuffmanCode(m_huffman_encoding_tables[table_id], m_huffman_encoding_tables[table_id | 2]);
+        component.m_last_dc = 0;
+    }
+    m_output << 0x00 << 0x3F << 0x00;
+
+    const auto rows_count = get_blocks_count(m_height, m_sampling.m_x);
+    const auto columns_count = get_blocks_count(m_width, m_sampling.m_y);
+    int rst_count = m_rst_interval, next_rst = 0;
+    for (std::size_t global_block_x = 0; global_block_x < rows_count; ++global_block_x) {
+        for (std::size_t global_block_y = 0; global_block_y < columns_count; ++global_block_y) {
+            for (std::size_t i = 0; i < components_count; ++i) {
+                auto & component = m_components[i];
+                for (std::size_t block_x = 0; block_x < component.m_sampling.m_x; ++block_x) {
+                    for (std::size_t block_y = 0; block_y < component.m_sampling.m_y; ++block_y) {
+                        const auto & natural_block = blocks[i].at(global_block_y * component.m_sampling.m_y + block_y,
+                                                                  global_block_x * component.m_sampling.m_x + block_x);
+                        std::array<int, 64> zigzag_block;
+                        for (std::size_t k = 0; k < 64; ++k) {
+                            zigzag_block[k] = natural_block[utils::REVERSED_ZIGZAG_ORDER[k]];
+                        }
+                        write_block(component, zigzag_block, component.m_last_dc, utils::KeepAllEntry);
+                        component.m_last_dc = zigzag_block[0];
+                    }
+                }
+            }
+            const bool is_last_mcu = global_block_x + 1 == rows_count && global_block_y + 1 == columns_count;
+            if (m_rst_interval > 0 && --rst_count == 0 && !is_last_mcu) {
+                write_restart_marker(next_rst);
+                next_rst = (next_rst + 1) & 7;
+                rst_count = m_rst_interval;
+                for (auto & component : m_components) {
+                    component.m_last_dc = 0;
+                }
+            }
+        }
+    }
+
+    write_end_of_image();
+}
+
+std::map<std::size_t, Bytes<64>> Decoder::requantize_tables()
+{
+    const auto scale = utils::QuantizationTable::get_scale(*m_requantization_quality);
+    std::map<std::size_t, Bytes<64>> original_tables;
+    for (auto & [id, table] : m_quantization_tables) {
+        // As in the encoder, the luma gets the luminance table and the chroma the chrominance one
+        const utils::QuantizationTable base(id == m_components.front().m_quantization_table_id
+                                                    ? constants::luminance::QUANTIZATION_TABLE
+                                                    : constants::chrominance::QUANTIZATION_TABLE,
+                                            scale);
+        const auto & original = original_tables.emplace(id, get_zigzag_steps(table)).first->second;
+        int steps[64];
+        for (std::size_t k = 0; k < 64; ++k) {
+            steps[k] = std::max(original[k], base.get()[k]);
+        }
+        table = utils::QuantizationTable(steps);
+    }
+    return original_tables;
+}
+
+void Decoder::subsample_chroma(std::vector<LosslessTransform::Blocks> & blocks)
+{
+    if (m_components.size() != 3) {
+        throw DecodingException("Chroma subsampling requires YCbCr image", DecodingException::Reason::UNSUPPORTED);
+    }
+    for (const auto & component : m_components) {
+        if (component.m_sampling.m_x != 1 || component.m_sampling.m_y != 1) {
+            throw DecodingException("Chroma subsampling requires 4:4:4 image", DecodingException::Reason::UNSUPPORTED);
+        }
+    }
+    const auto width = get_blocks_count(m_width, 2) * 2;
+    const auto height = get_blocks_count(m_height, 2) * 2;
+
+    auto & luma = blocks.front();
+    LosslessTransform::Blocks padded_luma;
+    padded_luma.m_width = width;
+    padded_luma.m_height = height;
+    padded_luma.m_blocks.resize(width * height);
+    for (std::size_t y = 0; y < height; ++y) {
+        for (std::size_t x = 0; x < width; ++x) {
+            padded_luma.at(x, y) = luma.at(std::min(x, luma.m_width - 1), std::min(y, luma.m_height - 1));
+        }
+    }
+    luma = std::move(padded_luma);
+
+    for (std::size_t i = 1; i < m_components.size(); ++i) {
+        const auto steps = get_zigzag_steps(m_quantization_tables.at(m_components[i].m_quantization_table_id));
+        std::array<float, 64> natural_steps;
+        for (std::size_t n = 0; n < 64; ++n) {
+            natural_steps[n] = steps[utils::ZIGZAG_ORDER[n]];
+        }
+        const auto & chroma = blocks[i];
+        LosslessTransform::Blocks subsampled;
+        subsampled.m_width = width / 2;
+        subsampled.m_height = height / 2;
+        subsampled.m_blocks.resize(subsampled.m_width * subsampled.m_height);
+        for (std::size_t y = 0; y < subsampled.m_height; ++y) {
+            for (std::size_t x = 0; x < subsampled.m_width; ++x) {
+                std::array<std::array<float, 64>, 4> group;
+                for (std::size_t j = 0; j < 4; ++j) {
+                    const auto & block = chroma.at(std::min(2 * x + j % 2, chroma.m_width - 1), std::min(2 * y + j / 2, chroma.m_height - 1));
+                    for (std::size_t n = 0; n < 64; ++n) {
+                        group[j][n] = block[n] * natural_steps[n];
+                    }
+                }
+                const auto merged = utils::DiscreteCosineTransform::downsample(group);
+                auto & to = subsampled.at(x, y);
+                for (std::size_t n = 0; n < 64; ++n) {
+                    to[n] = static_cast<int>(std::lround(merged[n] / natural_steps[n]));
+                }
+            }
+        }
+        blocks[i] = std::move(subsampled);
+    }
+
+    m_components.front().m_sampling = {2, 2};
+    m_sampling = {2, 2};
+}
+
+void Decoder::horizontal_upsample(Component & component)
+{
+    const auto & kernels = utils::get_kernels();
+    utils::Plane out((component.m_width * component.m_height) << 1, m_arena);
+    for (std::size_t y = 0; y < component.m_height; ++y) {
+        kernels.m_upsample_row(&component.m_pixels[y * component.m_stride],
+                               component.m_width,
+                               component.m_stride,
+                               &out[(y * component.m_width) << 1]);
+    }
+    component.m_width <<= 1;
+    component.m_stride = component.m_width;
+    component.m_pixels = out;
+}
+
+void Decoder::vertical_upsample(Component & c)
+{
+    // Weights of the rows of the cubic filter: 2, 3 and 4 taps at the borders
+    // and inside, the missing taps are zero.
+    static constexpr std::array<int, 4> Edge2{139, -11, 0, 0};
+    static constexpr std::array<int, 4> Edge3X{104, 27, -3, 0};
+    static constexpr std::array<int, 4> Edge3A{28, 109, -9, 0};
+    static constexpr std::array<int, 4> Inner4A{-9, 111, 29, -3};
+    static constexpr std::array<int, 4> Inner4B{-3, 29, 111, -9};
+
+    const auto & kernels = utils::get_kernels();
+    const auto w = c.m_width, h = c.m_height;
+    utils::Plane out((w * h) << 1, m_arena);
+    const auto row = [&c](const std::size_t y) { return &c.m_pixels[y * c.m_stride]; };
+    auto * cout = out.data();
+    const auto filter = [&](const Byte * a, const Byte * b, const Byte * d, const Byte * e, const std::array<int, 4> & weights) {
+        kernels.m_filter_rows(a, b, d, e, weights, cout, w);
+        cout += w;
+    };
+
+    filter(row(0), row(1), row(0), row(0), Edge2);
+    filter(row(0), row(1), row(2), row(0), Edge3X);
+    filter(row(0), row(1), row(2), row(0), Edge3A);
+    for (std::size_t y = 1; y + 2 < h; ++y) {
+        filter(row(y - 1), row(y), row(y + 1), row(y + 2), Inner4A);
+        filter(row(y - 1), row(y), row(y + 1), row(y + 2), Inner4B);
+    }
+    filter(row(h - 1), row(h - 2), row(h - 3), row(h - 1), Edge3A);
+    filter(row(h - 1), row(h - 2), row(h - 3), row(h - 1), Edge3X);
+    filter(row(h - 1), row(h - 2), row(h - 1), row(h - 1), Edge2);
+
+    c.m_height <<= 1;
+    c.m_stride = c.m_width;
+    c.m_pixels = out;
+}
+
+void Decoder::convert()
+{
+    for (auto & component : m_components) {
+        while ((component.m_width < m_width) || (component.m_height < m_height)) {
+            if (component.m_width < m_width)
+                horizontal_upsample(component);
+            if (component.m_height < m_height)
+                vertical_upsample(component);
+        }
+        if (component.m_width < m_width || component.m_height < m_height) {
+            throw DecodingException("Internal application error occured", DecodingException::Reason::INTERNAL_ERROR);
+        }
+    }
+
+    if (m_components.size() == 3) {
+        // convert to RGB
+        const auto & kernels = utils::get_kernels();
+        for (std::size_t y = 0; y < m_height; ++y) {
+            kernels.m_ycbcr_to_rgb(&m_components[0].m_pixels[y * m_components[0].m_stride],
+                                   &m_components[1].m_pixels[y * m_components[1].m_stride],
+                                   &m_components[2].m_pixels[y * m_components[2].m_stride],
+                                   &m_rgb[y * m_width * 3],
+                                   m_width);
+        }
+        return;
+    }
+
+    auto & component = m_components[0];
+    if (component.m_width == component.m_stride) {
         return;
     }
 
@@ -715,28 +1863,52 @@ void Decoder::reset()
 {
     Decoder decoder{};
     std::swap(*this, decoder);
+
+    // The buffers of the previous image are recycled instead of freed
+    std::swap(m_arena, decoder.m_arena);
+    std::swap(m_output, decoder.m_output);
+    std::swap(m_retained_blocks, decoder.m_retained_blocks);
+    m_arena.release();
+    m_output.clear();
+    m_retained_blocks.clear();
 }
 
 void Decoder::decode(const BytesList & jpeg)
 {
-    m_position = jpeg.data();
-    m_size = jpeg.size();
+    decode(jpeg.data(), jpeg.size());
+}
+
+void Decoder::decode(const unsigned char * jpeg, const std::size_t size)
+{
+    m_position = jpeg;
+    m_size = size;
 
-    if (jpeg.size() < 2 || m_position[0] != 0xFF || m_position[1] != 0xD8) {
+    if (size < 2 || m_position[0] != 0xFF || m_position[1] != 0xD8) {
         throw DecodingException("SOI (Start of Image) marker not found", DecodingException::Reason::NO_JPEG);
     }
     skip(2); // Skip SOI marker
+    if (IsWritingArithmeticResiduals()) {
+        write_arithmetic_segment();
+    }
 
     while (!m_decoding_finished) {
         if (m_size < 2 || m_position[0] != 0xFF) {
             throw DecodingException("Marker not found", DecodingException::Reason::SYNTAX_ERROR);
         }
-        skip(2); // Skip marker
-
-        switch (m_position[-1]) {
+        if (decode_arithmetic_segment()) {
+            continue;
+        }
+        switch (read_marker()) {
         case 0xC0:
             decode_start_of_frame();
             break;
+        case 0xC9:
+            m_is_arithmetic_frame = true;
+            decode_start_of_frame();
+            break;
+        case 0xCC:
+            decode_arithmetic_conditioning();
+            break;
         case 0xC4:
             decode_huffman_tables();
             break;
@@ -752,6 +1924,9 @@ void Decoder::decode(const BytesList & jpeg)
         case 0xFE:
             skip_marker();
             break;
+        case ScanIndex::SegmentMarker:
+            decode_scan_index_segment();
+            break;
         default:
             if ((m_position[-1] & 0xF0) == 0xE0) {
                 skip_marker();
@@ -761,7 +1936,32 @@ void Decoder::decode(const BytesList & jpeg)
             }
         }
     }
-    convert();
+    if (IsTransformMode()) {
+        write_transformed_image();
+        return;
+    }
+    if (m_is_luma_only) {
+        m_components.resize(1);
+    }
+    const bool is_region = m_region.has_value();
+    if (is_region) {
+        crop_to_region();
+    }
+    if (m_is_planar_output && !IsTranscoding()) {
+        if (is_region) {
+            finish_planar_region();
+        }
+    }
+    else {
+        convert();
+        if (is_region) {
+            finish_region();
+        }
+    }
+
+    if (IsTranscoding()) {
+        encode_retained_residuals();
+    }
 }
 
 std::size_t Decoder::get_width() const
@@ -779,7 +1979,17 @@ bool Decoder::is_color_image() const
     return m_components.size() != 1;
 }
 
-const BytesList & Decoder::get_image() const
+const Decoder::Component & Decoder::get_component(const std::size_t index) const
+{
+    return m_components.at(index);
+}
+
+const Decoder::Sampling & Decoder::get_sampling() const
+{
+    return m_sampling;
+}
+
+const utils::Plane & Decoder::get_image() const
 {
     return (m_components.size() == 1) ? m_components.front().m_pixels : m_rgb;
 }
@@ -794,6 +2004,32 @@ const Output & Decoder::get_output() const
     return m_output;
 }
 
+std::size_t Decoder::get_allocations_count() const
+{
+    return m_arena.get_allocations_count();
+}
+
+const std::optional<ScanIndex> & Decoder::get_scan_index() const
+{
+    return m_scan_index;
+}
+
+const std::vector<Decoder::DamagedRange> & Decoder::get_damaged_ranges() const
+{
+    return m_damaged_ranges;
+}
+
+utils::DCTCoefficientsFilter Decoder::get_dct_filter() const
+{
+    return m_is_adaptive_dct_filter ? utils::DCTCoefficientsFilter::adaptive(m_dct_filter_power)
+                                    : utils::DCTCoefficientsFilter(m_dct_filter_power);
+}
+
+const std::array<Decoder::BlockClassStatistics, utils::BlockClassesCount> & Decoder::get_block_class_statistics() const
+{
+    return m_block_class_statistics;
+}
+
 Decoder::Sampling & Decoder::Sampling::set_greater(const Sampling & other)
 {
     m_y = std::max(m_y, other.m_y);
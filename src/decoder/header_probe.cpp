@@ -0,0 +1,157 @@
+/**
+ * @file header_probe.cpp
+ * @brief Parsing of the segments before the first scan of JPEG.
+ */
+
+#include "decoder/header_probe.hpp"
+
+#include "decoder/decoding_exception.hpp"
+#include "encoder/constants.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+std::size_t read_16(const unsigned char * position)
+{
+    return (position[0] << 8) | position[1];
+}
+
+/** SOF markers are 0xC0-0xCF except DHT, JPG and DAC. */
+bool is_start_of_frame(const unsigned char marker)
+{
+    return (marker & 0xF0) == 0xC0 && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+void parse_start_of_frame(HeaderProbe & header, const unsigned char * segment, const std::size_t length)
+{
+    if (length < 6) {
+        throw DecodingException("Lenght of SOF is too small", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    header.m_precision = segment[0];
+    header.m_height = read_16(segment + 1);
+    header.m_width = read_16(segment + 3);
+    const std::size_t components_count = segment[5];
+    if (length < 6 + 3 * components_count) {
+        throw DecodingException("Incomplete image channels description", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    header.m_components.resize(components_count);
+    for (std::size_t i = 0; i < components_count; ++i) {
+        const auto * description = segment + 6 + 3 * i;
+        auto & component = header.m_components[i];
+        component.m_id = description[0];
+        component.m_horizontal_sampling = description[1] >> 4;
+        component.m_vertical_sampling = description[1] & 0xF;
+        component.m_quantization_table_id = description[2];
+    }
+}
+
+void parse_quantization_tables(HeaderProbe & header, const unsigned char * segment, std::size_t length)
+{
+    while (length > 0) {
+        // The high half of the byte is the precision: 8 or 16 bit steps
+        const bool is_16_bit = segment[0] >> 4;
+        const std::size_t id = segment[0] & 0xF;
+        const std::size_t table_size = is_16_bit ? 128 : 64;
+        if (length < 1 + table_size || id > 3) {
+            throw DecodingException("Syntax error", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        auto & table = header.m_quantization_tables[id];
+        for (std::size_t k = 0; k < 64; ++k) {
+            table[k] = is_16_bit ? read_16(segment + 1 + 2 * k) : segment[1 + k];
+        }
+        segment += 1 + table_size;
+        length -= 1 + table_size;
+    }
+}
+
+} // namespace
+
+bool HeaderProbe::is_progressive() const
+{
+    return m_frame_marker == 0xC2 || m_frame_marker == 0xC6 || m_frame_marker == 0xCA || m_frame_marker == 0xCE;
+}
+
+bool HeaderProbe::is_arithmetic() const
+{
+    return m_frame_marker >= 0xC9;
+}
+
+std::size_t HeaderProbe::estimate_quality() const
+{
+    if (m_components.empty()) {
+        return 0;
+    }
+    const auto table = m_quantization_tables.find(m_components.front().m_quantization_table_id);
+    if (table == m_quantization_tables.end()) {
+        return 0;
+    }
+    // The sums do not depend on the order, the standard table is in natural one
+    const auto & base = constants::luminance::QUANTIZATION_TABLE;
+    const double sum = std::accumulate(table->second.begin(), table->second.end(), 0.);
+    const double base_sum = std::accumulate(std::begin(base), std::end(base), 0.);
+    // Inverse of utils::QuantizationTable::get_scale
+    const auto scale = 100. * sum / base_sum;
+    const auto quality = scale <= 100. ? (200. - scale) / 2. : 5000. / scale;
+    return static_cast<std::size_t>(std::clamp(std::lround(quality), 1l, 100l));
+}
+
+HeaderProbe HeaderProbe::probe(const unsigned char * data, const std::size_t size)
+{
+    if (size < 2 || data[0] != 0xFF || data[1] != 0xD8) {
+        throw DecodingException("SOI (Start of Image) marker not found", DecodingException::Reason::NO_JPEG);
+    }
+    HeaderProbe header;
+    std::size_t position = 2;
+    while (true) {
+        if (position + 2 > size || data[position] != 0xFF) {
+            throw DecodingException("Marker not found", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        // Any number of 0xFF may precede the marker
+        while (position + 1 < size && data[position + 1] == 0xFF) {
+            ++position;
+        }
+        if (position + 1 >= size) {
+            throw DecodingException("Marker not found", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        const auto marker = data[position + 1];
+        position += 2;
+        // TEM and RST have no segment
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            continue;
+        }
+        if (marker == 0xD9) {
+            throw DecodingException("No scan in the image", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        if (position + 2 > size) {
+            throw DecodingException("Cannot decode lenght", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        const auto length = read_16(data + position);
+        if (length < 2 || position + length > size) {
+            throw DecodingException("Lenght is too long", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        const auto * segment = data + position + 2;
+        if (marker == 0xDA) {
+            if (header.m_frame_marker == 0) {
+                throw DecodingException("SOS before SOF", DecodingException::Reason::SYNTAX_ERROR);
+            }
+            return header;
+        }
+        if (is_start_of_frame(marker)) {
+            header.m_frame_marker = marker;
+            parse_start_of_frame(header, segment, length - 2);
+        }
+        else if (marker == 0xDB) {
+            parse_quantization_tables(header, segment, length - 2);
+        }
+        else if (marker == 0xDD) {
+            if (length != 4) {
+                throw DecodingException("Syntax error", DecodingException::Reason::SYNTAX_ERROR);
+            }
+            header.m_restart_interval = read_16(segment);
+        }
+        position += length;
+    }
+}
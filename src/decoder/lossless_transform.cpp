@@ -0,0 +1,141 @@
+/**
+ * @file lossless_transform.cpp
+ * @brief Transformations of the blocks and the coefficients in the DCT domain.
+ */
+
+#include "decoder/lossless_transform.hpp"
+
+#include "utils/zigzag.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+inline static constexpr std::pair<LosslessTransform::Operation, const char *> Operations[] = {
+        {LosslessTransform::Operation::FLIP_HORIZONTAL, "flip-horizontal"},
+        {LosslessTransform::Operation::FLIP_VERTICAL, "flip-vertical"},
+        {LosslessTransform::Operation::TRANSPOSE, "transpose"},
+        {LosslessTransform::Operation::TRANSVERSE, "transverse"},
+        {LosslessTransform::Operation::ROTATE_90, "rotate-90"},
+        {LosslessTransform::Operation::ROTATE_180, "rotate-180"},
+        {LosslessTransform::Operation::ROTATE_270, "rotate-270"},
+};
+
+std::size_t transpose(const std::size_t natural_index)
+{
+    return (natural_index % 8) * 8 + natural_index / 8;
+}
+
+} // namespace
+
+bool LosslessTransform::is_transposing() const
+{
+    return m_operation == Operation::TRANSPOSE || m_operation == Operation::TRANSVERSE ||
+            m_operation == Operation::ROTATE_90 || m_operation == Operation::ROTATE_270;
+}
+
+bool LosslessTransform::is_mirroring_columns() const
+{
+    return m_operation == Operation::FLIP_HORIZONTAL || m_operation == Operation::TRANSVERSE ||
+            m_operation == Operation::ROTATE_180 || m_operation == Operation::ROTATE_270;
+}
+
+bool LosslessTransform::is_mirroring_rows() const
+{
+    return m_operation == Operation::FLIP_VERTICAL || m_operation == Operation::TRANSVERSE ||
+            m_operation == Operation::ROTATE_90 || m_operation == Operation::ROTATE_180;
+}
+
+void LosslessTransform::transform_block(std::array<int, 64> & block) const
+{
+    if (is_transposing()) {
+        for (std::size_t v = 0; v < 8; ++v) {
+            for (std::size_t u = v + 1; u < 8; ++u) {
+                std::swap(block[v * 8 + u], block[u * 8 + v]);
+            }
+        }
+    }
+    // Mirroring of the block negates its odd frequencies in that direction
+    const auto is_mirroring_x = is_transposing() ? is_mirroring_rows() : is_mirroring_columns();
+    const auto is_mirroring_y = is_transposing() ? is_mirroring_columns() : is_mirroring_rows();
+    for (std::size_t v = 0; v < 8; ++v) {
+        for (std::size_t u = 0; u < 8; ++u) {
+            if ((is_mirroring_x && (u & 1)) != (is_mirroring_y && (v & 1))) {
+                block[v * 8 + u] = -block[v * 8 + u];
+            }
+        }
+    }
+}
+
+Bytes<64> LosslessTransform::transform_quantization_table(const Bytes<64> & table) const
+{
+    if (!is_transposing()) {
+        return table;
+    }
+    Bytes<64> result;
+    for (std::size_t i = 0; i < 64; ++i) {
+        result[i] = table[utils::ZIGZAG_ORDER[transpose(utils::REVERSED_ZIGZAG_ORDER[i])]];
+    }
+    return result;
+}
+
+LosslessTransform::Blocks LosslessTransform::transform(const Blocks & blocks, const std::size_t width, const std::size_t height) const
+{
+    Blocks result;
+    result.m_width = is_transposing() ? height : width;
+    result.m_height = is_transposing() ? width : height;
+    result.m_blocks.resize(width * height);
+    for (std::size_t y = 0; y < height; ++y) {
+        for (std::size_t x = 0; x < width; ++x) {
+            auto to_x = is_mirroring_columns() ? width - 1 - x : x;
+            auto to_y = is_mirroring_rows() ? height - 1 - y : y;
+            if (is_transposing()) {
+                std::swap(to_x, to_y);
+            }
+            auto & block = result.at(to_x, to_y);
+            block = blocks.at(x, y);
+            transform_block(block);
+        }
+    }
+    return result;
+}
+
+LosslessTransform::Blocks LosslessTransform::crop(const Blocks & blocks, const std::size_t x, const std::size_t y, const std::size_t width, const std::size_t height)
+{
+    Blocks result;
+    result.m_width = width;
+    result.m_height = height;
+    result.m_blocks.reserve(width * height);
+    for (std::size_t row = y; row < y + height; ++row) {
+        const auto begin = blocks.m_blocks.begin() + row * blocks.m_width + x;
+        result.m_blocks.insert(result.m_blocks.end(), begin, begin + width);
+    }
+    return result;
+}
+
+LosslessTransform::Operation LosslessTransform::parse_operation(const std::string & name)
+{
+    for (const auto & [operation, operation_name] : Operations) {
+        if (name == operation_name) {
+            return operation;
+        }
+    }
+    throw std::invalid_argument("Unknown transform: " + name);
+}
+
+LosslessTransform::Crop LosslessTransform::parse_crop(const std::string & geometry)
+{
+    Crop crop;
+    int parsed_size = 0;
+    const auto * text = geometry.c_str();
+    if (std::sscanf(text, "%zux%zu+%zu+%zu%n", &crop.m_width, &crop.m_height, &crop.m_x, &crop.m_y, &parsed_size) != 4) {
+        crop = {};
+        std::sscanf(text, "%zux%zu%n", &crop.m_width, &crop.m_height, &parsed_size);
+    }
+    if (static_cast<std::size_t>(parsed_size) != geometry.size() || crop.m_width == 0 || crop.m_height == 0) {
+        throw std::invalid_argument("Invalid crop region: " + geometry);
+    }
+    return crop;
+}
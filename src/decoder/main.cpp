@@ -1,7 +1,13 @@
 #include "decoder/decoder.hpp"
 #include "decoder/decoding_exception.hpp"
+#include "utils/kernels.hpp"
+#include "utils/qecnn.hpp"
 
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <memory>
+#include <tuple>
 
 // Third-party:
 #include <args.hxx>
@@ -14,6 +20,106 @@ std::size_t size_of(std::ifstream & file)
     return size;
 }
 
+/**
+ * @brief Runs the external enhancement command on the zeroed out image.
+ *
+ * The image is passed through temporary PPM files, which are substituted
+ * into the command instead of {input} and {output} placeholders.
+ */
+utils::Image enhance_with_command(const std::string & command, const std::string & output_file_name, const utils::Image & image)
+{
+    const auto input = output_file_name + ".zeroed.ppm";
+    const auto output = output_file_name + ".enhanced.ppm";
+    image.to_ppm(input);
+
+    auto substituted = command;
+    for (const auto & [placeholder, value] : {std::pair{std::string("{input}"), input}, std::pair{std::string("{output}"), output}}) {
+        for (auto position = substituted.find(placeholder); position != std::string::npos; position = substituted.find(placeholder, position + value.size())) {
+            substituted.replace(position, placeholder.size(), value);
+        }
+    }
+
+    const auto status = std::system(substituted.c_str());
+    std::remove(input.c_str());
+    if (status != 0) {
+        std::remove(output.c_str());
+        throw std::runtime_error("Enhancement command failed: " + substituted);
+    }
+    auto enhanced = utils::Image::from_ppm(output);
+    std::remove(output.c_str());
+    return enhanced;
+}
+
+/**
+ * @brief Prints the sizes of the luma blocks before and after transcoding
+ * for every class of blocks.
+ */
+void print_block_class_statistics(const Decoder & decoder)
+{
+    const auto filter = decoder.get_dct_filter();
+    const auto & statistics = decoder.get_block_class_statistics();
+    std::cout << "class\tpower\tblocks\tinput bytes\toutput bytes\tsavings\n";
+    for (std::size_t i = 0; i < statistics.size(); ++i) {
+        const auto block_class = static_cast<utils::BlockClass>(i);
+        const auto & s = statistics[i];
+        const auto savings = s.m_input_bits == 0 ? 0. : 100. * (1. - static_cast<double>(s.m_output_bits) / s.m_input_bits);
+        std::cout << utils::to_string(block_class) << '\t' << filter.get_power(block_class) << '\t' << s.m_blocks_count << '\t'
+                  << s.m_input_bits / 8 << '\t' << s.m_output_bits / 8 << '\t' << savings << "%\n";
+    }
+}
+
+/**
+ * @brief Returns the Y4M colorspace of the image by the sampling of the chroma
+ * relative to the luma, or nullptr if Y4M has no such one.
+ */
+const char * get_y4m_colorspace(const Decoder & decoder)
+{
+    static constexpr std::tuple<std::size_t, std::size_t, const char *> Colorspaces[] = {
+            {1, 1, "444"},
+            {2, 2, "420jpeg"},
+            {2, 1, "422"},
+            {4, 1, "411"},
+    };
+
+    if (!decoder.is_color_image()) {
+        return "mono";
+    }
+    const auto & sampling = decoder.get_sampling();
+    const auto & luma = decoder.get_component(0).m_sampling;
+    const auto & blue = decoder.get_component(1).m_sampling;
+    const auto & red = decoder.get_component(2).m_sampling;
+    if (luma.m_x != sampling.m_x || luma.m_y != sampling.m_y || blue.m_x != red.m_x || blue.m_y != red.m_y ||
+        sampling.m_y % blue.m_y != 0 || sampling.m_x % blue.m_x != 0) {
+        return nullptr;
+    }
+    for (const auto & [horizontal, vertical, colorspace] : Colorspaces) {
+        if (sampling.m_y / blue.m_y == horizontal && sampling.m_x / blue.m_x == vertical) {
+            return colorspace;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Writes the planes of the image at their own sampling as a single
+ * frame of Y4M video.
+ */
+bool write_y4m(const Decoder & decoder, std::ofstream & output)
+{
+    const auto * colorspace = get_y4m_colorspace(decoder);
+    if (colorspace == nullptr) {
+        return false;
+    }
+    output << "YUV4MPEG2 W" << decoder.get_width() << " H" << decoder.get_height() << " F25:1 Ip A1:1 C" << colorspace << "\nFRAME\n";
+    for (std::size_t i = 0; i < (decoder.is_color_image() ? 3 : 1); ++i) {
+        const auto & component = decoder.get_component(i);
+        for (std::size_t row = 0; row < component.m_height; ++row) {
+            output.write(reinterpret_cast<const char *>(&component.m_pixels[row * component.m_stride]), component.m_width);
+        }
+    }
+    return true;
+}
+
 int main(const int argc, const char * argv[])
 {
     args::ArgumentParser parser("JPEG Decoder");
@@ -30,8 +136,40 @@ int main(const int argc, const char * argv[])
     args::Flag encode_residuals_flag(
             mode_group, "encode_residuals", "Encode the difference between the AC coefficients of the original image and the predicted one", {"encode_residuals"});
     args::Flag decode_residuals_flag(mode_group, "decode-residuals", "Decompress transcoded image", {"decode_residuals"});
+    args::Flag transcode_flag(mode_group, "transcode", "Zero out, enhance and encode residuals in a single pass", {"transcode"});
+    args::Flag transdecode_flag(mode_group, "transdecode", "Zero out, enhance and decode residuals in a single pass", {"transdecode"});
+    args::ValueFlag<std::string> transform_flag(mode_group,
+                                                "operation",
+                                                "Transform the image losslessly: flip-horizontal, flip-vertical, transpose, transverse, rotate-90, rotate-180 or rotate-270",
+                                                {"transform"});
+    args::ValueFlag<std::size_t> quality_flag(
+            parser, "quality", "Requantize the coefficients to the tables of the encoder of the quality (1-100)", {'q', "quality"});
+    args::ValueFlag<std::string> crop_flag(parser, "geometry", "Crop the image losslessly to WxH+X+Y, X and Y are aligned down to MCU", {"crop"});
+    args::Flag subsample_chroma_flag(parser, "subsample-chroma", "Convert 4:4:4 image to 4:2:0 in the DCT domain", {"subsample-chroma"});
+
+    args::Group enhancer_group(parser, "Enhancers (transcode and transdecode modes):", args::Group::Validators::AtMostOne);
+    args::ValueFlag<std::string> model_file_name_flag(enhancer_group, "model_file_name", "The converted QE-CNN checkpoint", {'m', "model"});
+    args::ValueFlag<std::string> enhance_command_flag(
+            enhancer_group, "enhance_command", "The enhancement command with {input} and {output} placeholders", {"enhance-command"});
 
     args::ValueFlag<std::size_t> filter_power_flag(parser, "filter", "The power of the DCT coefficient filter", {'p', "power"}, 16);
+    args::Flag adaptive_flag(parser, "adaptive", "Choose the power of the filter for every luma block by its class", {"adaptive"});
+    args::Flag arithmetic_flag(parser, "arithmetic", "Write the residuals with the built-in arithmetic coder", {"arithmetic"});
+
+    args::Group index_group(parser, "Scan index:", args::Group::Validators::AtMostOne);
+    args::ValueFlag<std::string> build_index_flag(index_group, "index_file_name", "Build the scan seek index and write it to the file", {"build-index"});
+    args::ValueFlag<std::string> embed_index_flag(
+            index_group, "jpeg_file_name", "Build the scan seek index and write the input image with it as APP9 segment", {"embed-index"});
+    args::ValueFlag<std::string> index_flag(index_group, "index_file_name", "Decode using the scan seek index from the file", {"index"});
+    args::ValueFlag<std::size_t> index_rows_flag(parser, "index_rows", "Number of MCU rows between the scan index entries", {"index-rows"}, 16);
+    args::ValueFlag<std::size_t> threads_flag(parser, "threads", "Number of threads decoding the indexed scan, 0 means all cores", {'t', "threads"}, 0);
+    args::ValueFlag<std::size_t> first_row_flag(parser, "first_row", "The first row of the decoded region", {"first-row"}, 0);
+    args::ValueFlag<std::size_t> rows_flag(parser, "rows", "Height of the decoded region", {"rows"});
+    args::Flag planar_flag(parser, "planar", "Write the components at their own sampling as Y4M instead of RGB PPM", {"planar"});
+    args::Flag luma_only_flag(parser, "luma_only", "Decode only the luma and write it as grayscale image", {"luma-only"});
+    args::Flag resilient_flag(
+            parser, "resilient", "Skip corrupt data up to the next RST or EOI marker and fill the lost MCUs instead of failing", {"resilient"});
+    args::ValueFlag<std::string> isa_flag(parser, "isa", "Use the kernels built for the instruction set: scalar, sse4.2, avx2 or avx512", {"force-isa"});
 
     try {
         parser.ParseCLI(argc, argv);
@@ -51,6 +189,39 @@ int main(const int argc, const char * argv[])
         return 1;
     }
 
+    if (isa_flag) {
+        try {
+            utils::force_isa(utils::parse_isa(args::get(isa_flag)));
+        }
+        catch (const std::exception & e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    }
+
+    LosslessTransform transform;
+    try {
+        if (transform_flag) {
+            transform.m_operation = LosslessTransform::parse_operation(args::get(transform_flag));
+        }
+        if (crop_flag) {
+            transform.m_crop = LosslessTransform::parse_crop(args::get(crop_flag));
+        }
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    if ((crop_flag || quality_flag || subsample_chroma_flag) && (compress_and_decode_flag || encode_residuals_flag || decode_residuals_flag || transcode_flag || transdecode_flag)) {
+        std::cerr << "--crop, --quality and --subsample-chroma can only be combined with --transform\n";
+        return 1;
+    }
+    if (quality_flag && (args::get(quality_flag) < 1 || args::get(quality_flag) > 100)) {
+        std::cerr << "The quality value should be from 1 to 100 inclusive\n";
+        return 1;
+    }
+    const bool is_transforming = transform_flag || crop_flag || quality_flag || subsample_chroma_flag;
+
     auto & input_file_name = args::get(input_file_name_flag);
     std::ifstream file(input_file_name, std::ios::binary);
     if (!file.is_open()) {
@@ -68,6 +239,11 @@ int main(const int argc, const char * argv[])
     file.close();
 
     Decoder decoder;
+    decoder.set_adaptive_dct_filter(args::get(adaptive_flag))
+            .set_arithmetic_residuals(args::get(arithmetic_flag))
+            .set_planar_output(args::get(planar_flag))
+            .set_luma_only(args::get(luma_only_flag))
+            .set_error_resilience(args::get(resilient_flag));
     if (compress_and_decode_flag) {
         decoder.toggle_mode(Decoder::Mode::ZERO_OUT_AND_DECODE).set_dct_filter(args::get(filter_power_flag));
     }
@@ -81,18 +257,77 @@ int main(const int argc, const char * argv[])
                 .set_dct_filter(args::get(filter_power_flag))
                 .set_enhanced_file(args::get(enhanced_file_name_flag));
     }
+    else if (transcode_flag || transdecode_flag) {
+        decoder.toggle_mode(transcode_flag ? Decoder::Mode::TRANSCODE : Decoder::Mode::TRANSDECODE)
+                .set_dct_filter(args::get(filter_power_flag));
+        if (model_file_name_flag) {
+            auto model = std::make_shared<utils::QECNN>(utils::QECNN::from_file(args::get(model_file_name_flag)));
+            decoder.set_enhancer([model](const utils::Image & image) { return model->enhance(image); });
+        }
+        else if (enhance_command_flag) {
+            decoder.set_enhancer([command = args::get(enhance_command_flag), output = args::get(output_file_name_flag)](const utils::Image & image) {
+                return enhance_with_command(command, output, image);
+            });
+        }
+        else {
+            std::cerr << "Either --model or --enhance-command is required in transcode and transdecode modes\n";
+            return 1;
+        }
+    }
+    else if (is_transforming) {
+        decoder.toggle_mode(Decoder::Mode::TRANSFORM).set_lossless_transform(transform);
+        if (quality_flag) {
+            decoder.set_requantization_quality(args::get(quality_flag));
+        }
+        decoder.set_chroma_subsampling(args::get(subsample_chroma_flag));
+    }
 
     try {
+        if (build_index_flag || embed_index_flag) {
+            decoder.set_scan_index_interval(args::get(index_rows_flag));
+        }
+        else if (index_flag) {
+            decoder.set_scan_index(ScanIndex::from_file(args::get(index_flag)));
+        }
+        decoder.set_threads_count(args::get(threads_flag));
+        if (rows_flag) {
+            decoder.set_region(args::get(first_row_flag), args::get(rows_flag));
+        }
+
         decoder.decode(buffer);
+
+        for (const auto & range : decoder.get_damaged_ranges()) {
+            std::cerr << "Damaged MCUs " << range.m_first_mcu << '-' << range.m_first_mcu + range.m_mcus_count - 1 << " of " << input_file_name
+                      << " are filled\n";
+        }
+
+        if (build_index_flag) {
+            decoder.get_scan_index()->to_file(args::get(build_index_flag));
+        }
+        else if (embed_index_flag) {
+            const auto embedded = decoder.get_scan_index()->embed(buffer);
+            std::ofstream output(args::get(embed_index_flag), std::ios::binary);
+            if (!output.write(reinterpret_cast<const char *>(embedded.data()), embedded.size())) {
+                throw std::runtime_error("Error writing file: " + args::get(embed_index_flag));
+            }
+        }
     }
     catch (const DecodingException & e) {
         std::cout << "Error occured while decoding file " << input_file_name << ": " << e.what() << std::endl;
         return 3;
     }
+    catch (const std::runtime_error & e) {
+        std::cerr << "Error occurred while processing file " << input_file_name << ": " << e.what() << std::endl;
+        return 5;
+    }
 
     auto & output_file_name = args::get(output_file_name_flag);
 
-    if (encode_residuals_flag || decode_residuals_flag) {
+    if (adaptive_flag && (encode_residuals_flag || transcode_flag)) {
+        print_block_class_statistics(decoder);
+    }
+
+    if (encode_residuals_flag || decode_residuals_flag || transcode_flag || transdecode_flag || is_transforming) {
         decoder.get_output().to_file(output_file_name);
     }
     else {
@@ -102,9 +337,17 @@ int main(const int argc, const char * argv[])
             return 4;
         }
 
-        output << "P" << (decoder.is_color_image() ? 6 : 5) << "\n"
-               << decoder.get_width() << " " << decoder.get_height() << "\n255\n";
-        output.write(reinterpret_cast<const char *>(decoder.get_image().data()), decoder.get_image_size());
+        if (planar_flag) {
+            if (!write_y4m(decoder, output)) {
+                std::cout << "Y4M does not support the chroma sampling of the image " << input_file_name << '\n';
+                return 4;
+            }
+        }
+        else {
+            output << "P" << (decoder.is_color_image() ? 6 : 5) << "\n"
+                   << decoder.get_width() << " " << decoder.get_height() << "\n255\n";
+            output.write(reinterpret_cast<const char *>(decoder.get_image().data()), decoder.get_image_size());
+        }
         output.close();
     }
 
@@ -0,0 +1,150 @@
+/**
+ * @file scan_index.cpp
+ * @brief Serialization of the scan seek index.
+ */
+
+#include "decoder/scan_index.hpp"
+
+#include "decoder/decoding_exception.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+inline static constexpr char Signature[8] = {'S', 'C', 'A', 'N', 'I', 'D', 'X', 1};
+
+/** Maximal size of the JPEG segment payload. */
+inline static constexpr std::size_t MaxSegmentSize = 0xFFFF - 2;
+
+void write(BytesList & output, const std::uint64_t value, const std::size_t bytes_count)
+{
+    for (std::size_t i = bytes_count; i-- > 0;) {
+        output.push_back(static_cast<Byte>(value >> (8 * i)));
+    }
+}
+
+class Reader
+{
+public:
+    Reader(const unsigned char * data, const std::size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    std::uint64_t read(const std::size_t bytes_count)
+    {
+        if (m_size < bytes_count) {
+            throw DecodingException("Scan index is truncated", DecodingException::Reason::SYNTAX_ERROR);
+        }
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < bytes_count; ++i) {
+            value = (value << 8) | m_data[i];
+        }
+        m_data += bytes_count;
+        m_size -= bytes_count;
+        return value;
+    }
+
+private:
+    const unsigned char * m_data;
+    std::size_t m_size;
+};
+
+} // namespace
+
+BytesList ScanIndex::to_bytes() const
+{
+    BytesList result(std::begin(Signature), std::end(Signature));
+    const std::size_t components_count = m_entries.empty() ? 0 : m_entries.front().m_dc_predictors.size();
+    write(result, m_rows_per_entry, 4);
+    write(result, m_scan_size, 8);
+    write(result, components_count, 1);
+    write(result, m_entries.size(), 4);
+    for (const auto & entry : m_entries) {
+        write(result, entry.m_mcu_row, 4);
+        write(result, entry.m_offset, 8);
+        write(result, entry.m_bits_count, 1);
+        write(result, entry.m_bits, 4);
+        write(result, entry.m_rst_count, 2);
+        write(result, entry.m_next_rst, 1);
+        for (const auto dc : entry.m_dc_predictors) {
+            write(result, static_cast<std::uint32_t>(dc), 4);
+        }
+    }
+    return result;
+}
+
+bool ScanIndex::is_scan_index(const unsigned char * data, const std::size_t size)
+{
+    return size >= sizeof(Signature) && std::memcmp(data, Signature, sizeof(Signature)) == 0;
+}
+
+ScanIndex ScanIndex::from_bytes(const unsigned char * data, const std::size_t size)
+{
+    if (!is_scan_index(data, size)) {
+        throw DecodingException("Not a scan index", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    Reader reader(data + sizeof(Signature), size - sizeof(Signature));
+
+    ScanIndex index;
+    index.m_rows_per_entry = reader.read(4);
+    index.m_scan_size = reader.read(8);
+    const auto components_count = reader.read(1);
+    index.m_entries.resize(reader.read(4));
+    for (auto & entry : index.m_entries) {
+        entry.m_mcu_row = reader.read(4);
+        entry.m_offset = reader.read(8);
+        entry.m_bits_count = reader.read(1);
+        entry.m_bits = reader.read(4);
+        entry.m_rst_count = static_cast<int>(reader.read(2));
+        entry.m_next_rst = static_cast<int>(reader.read(1));
+        for (std::size_t i = 0; i < components_count; ++i) {
+            entry.m_dc_predictors.push_back(static_cast<std::int32_t>(reader.read(4)));
+        }
+    }
+    if (index.m_rows_per_entry == 0 || index.m_entries.empty() || index.m_entries.front().m_mcu_row != 0) {
+        throw DecodingException("Invalid scan index", DecodingException::Reason::SYNTAX_ERROR);
+    }
+    return index;
+}
+
+void ScanIndex::to_file(const std::string & file_name) const
+{
+    const auto bytes = to_bytes();
+    std::ofstream file(file_name, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size())) {
+        throw std::runtime_error("Error writing scan index: " + file_name);
+    }
+}
+
+ScanIndex ScanIndex::from_file(const std::string & file_name)
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening scan index: " + file_name);
+    }
+    const BytesList bytes(std::istreambuf_iterator<char>(file), {});
+    return from_bytes(bytes.data(), bytes.size());
+}
+
+BytesList ScanIndex::embed(const BytesList & jpeg) const
+{
+    const auto payload = to_bytes();
+    if (payload.size() > MaxSegmentSize) {
+        throw std::runtime_error("Scan index does not fit into APP9 segment, increase the rows per entry");
+    }
+    if (jpeg.size() < 2 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        throw DecodingException("SOI (Start of Image) marker not found", DecodingException::Reason::NO_JPEG);
+    }
+
+    BytesList result(jpeg.begin(), jpeg.begin() + 2);
+    result.push_back(0xFF);
+    result.push_back(SegmentMarker);
+    write(result, payload.size() + 2, 2);
+    result.insert(result.end(), payload.begin(), payload.end());
+    result.insert(result.end(), jpeg.begin() + 2, jpeg.end());
+    return result;
+}
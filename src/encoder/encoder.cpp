@@ -3,15 +3,256 @@
 #include "encoder/constants.hpp"
 #include "encoder/implementation/encoder.hpp"
 #include "utils/image.hpp"
+#include "utils/image_reader.hpp"
+#include "utils/spsc_queue.hpp"
 
+#include <array>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+
+namespace {
+
+/** Image passing through the stages of the pipelined encoding. */
+struct Frame
+{
+    std::string m_output_file_name;
+    std::size_t m_width = 0;
+    std::size_t m_height = 0;
+    std::optional<utils::Image> m_image{};
+    implementation::Encoder::Coefficients m_coefficients{};
+    Output m_output{};
+    /** Refers to the output, so the frame is never moved. */
+    std::optional<implementation::Encoder> m_encoder{};
+};
+
+using FrameQueue = utils::SpscQueue<std::unique_ptr<Frame>>;
+
+} // namespace
 
 bool Encoder::encode(const std::string & file_name, const utils::Image & image, int quality)
 {
+    return encode(file_name, image, Options{quality});
+}
+
+bool Encoder::encode(const std::string & file_name, const utils::Image & image, const Options & options)
+{
+    if (options.m_target_size != 0) {
+        return encode_to_size(file_name, image, options).has_value();
+    }
+
+    Output output;
+    implementation::Encoder encoder(options.m_quality, image.get_components_count(), options.m_subsample, options.m_restart_interval, output);
+
+    write_headers(output, encoder, image.get_width(), image.get_height());
+
+    encoder.encode(image);
+
+    output.write(0b1111111, 7) // Do the bit alignment of the EOI marker
+            << 0xFF << 0xD9;
+
+    output.to_file(file_name);
+
+    return true;
+}
+
+std::optional<int> Encoder::encode_to_size(const std::string & file_name, const utils::Image & image, const Options & options)
+{
+    // The coefficients depend only on the subsampling, which by default
+    // changes with the quality, so they are transformed for each one lazily.
+    std::array<std::optional<implementation::Encoder::Coefficients>, 2> coefficients;
+    const auto encode_with_quality = [&](const int quality, Output & output) {
+        implementation::Encoder encoder(quality, image.get_components_count(), options.m_subsample, options.m_restart_interval, output);
+        auto & transformed = coefficients[encoder.m_subsample];
+        if (!transformed.has_value()) {
+            transformed = encoder.transform(image);
+        }
+
+        write_headers(output, encoder, image.get_width(), image.get_height());
+
+        encoder.encode(*transformed);
+
+        output.write(0b1111111, 7) // Do the bit alignment of the EOI marker
+                << 0xFF << 0xD9;
+    };
+
+    // The size grows with the quality, so the best one is found by bisection
+    std::optional<int> result;
+    int low = 1, high = 100;
+    while (low <= high) {
+        const auto quality = (low + high) / 2;
+        auto counting_output = Output::counting();
+        encode_with_quality(quality, counting_output);
+        if (counting_output.get_bits_count() / 8 <= options.m_target_size) {
+            result = quality;
+            low = quality + 1;
+        }
+        else {
+            high = quality - 1;
+        }
+    }
+
+    if (!result.has_value()) {
+        return std::nullopt;
+    }
+
     Output output;
-    implementation::Encoder encoder(quality, output);
+    encode_with_quality(*result, output);
+    output.to_file(file_name);
+
+    return result;
+}
+
+bool Encoder::encode(utils::ImageReader & reader, std::ostream & stream, int quality)
+{
+    return encode(reader, stream, Options{quality});
+}
+
+bool Encoder::encode(utils::ImageReader & reader, std::ostream & stream, const Options & options)
+{
+    if (options.m_target_size != 0) {
+        throw std::invalid_argument("The target size is not supported for the streaming encoding");
+    }
+
+    Output output;
+    implementation::Encoder encoder(options.m_quality, reader.get_components_count(), options.m_subsample, options.m_restart_interval, output);
+
+    write_headers(output, encoder, reader.get_width(), reader.get_height());
+    output.flush(stream);
+
+    // Each band holds whole MCU rows, so the blocks never cross the band border
+    // and the only partial band is the last one, where the rows are repeated
+    // exactly as in the case of the whole image.
+    const auto band_height = encoder.get_mcu_height();
+    while (const auto band = reader.read_rows(band_height)) {
+        encoder.encode(*band);
+        output.flush(stream);
+    }
+
+    output.write(0b1111111, 7) // Do the bit alignment of the EOI marker
+            << 0xFF << 0xD9;
+    output.flush(stream);
+
+    return true;
+}
+
+void Encoder::encode(const std::vector<Task> & tasks, const Options & options, const std::size_t queue_capacity)
+{
+    if (options.m_target_size != 0) {
+        throw std::invalid_argument("The target size is not supported for the pipelined encoding");
+    }
+    if (queue_capacity == 0) {
+        throw std::invalid_argument("The queue capacity should be positive");
+    }
+
+    FrameQueue read_frames(queue_capacity);
+    FrameQueue transformed_frames(queue_capacity);
+    FrameQueue encoded_frames(queue_capacity);
+
+    // The first exception stops all the stages and is rethrown at the end.
+    // The failed reading only closes the pipeline, so the images read before
+    // are still written.
+    std::exception_ptr exception;
+    std::exception_ptr read_exception;
+    std::mutex exception_mutex;
+    const auto run_stage = [&](const auto & stage) {
+        try {
+            stage();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+            read_frames.cancel();
+            transformed_frames.cancel();
+            encoded_frames.cancel();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.emplace_back([&]() {
+        run_stage([&]() {
+            for (const auto & task : tasks) {
+                auto frame = std::make_unique<Frame>();
+                frame->m_output_file_name = task.m_output_file_name;
+                try {
+                    frame->m_image.emplace(utils::Image::from_ppm(task.m_input_file_name));
+                }
+                catch (const std::exception & e) {
+                    read_exception = std::make_exception_ptr(std::runtime_error("Cannot read " + task.m_input_file_name + ": " + e.what()));
+                    break;
+                }
+                if (!read_frames.push(std::move(frame))) {
+                    return;
+                }
+            }
+            read_frames.close();
+        });
+    });
+    threads.emplace_back([&]() {
+        run_stage([&]() {
+            while (auto frame = read_frames.pop()) {
+                auto & image = *(*frame)->m_image;
+                (*frame)->m_width = image.get_width();
+                (*frame)->m_height = image.get_height();
+                auto & encoder = (*frame)->m_encoder.emplace(options.m_quality, image.get_components_count(), options.m_subsample, options.m_restart_interval, (*frame)->m_output);
+                (*frame)->m_coefficients = encoder.transform(image);
+                (*frame)->m_image.reset();
+                if (!transformed_frames.push(std::move(*frame))) {
+                    return;
+                }
+            }
+            transformed_frames.close();
+        });
+    });
+    threads.emplace_back([&]() {
+        run_stage([&]() {
+            while (auto frame = transformed_frames.pop()) {
+                auto & output = (*frame)->m_output;
+                auto & encoder = *(*frame)->m_encoder;
+
+                write_headers(output, encoder, (*frame)->m_width, (*frame)->m_height);
+
+                encoder.encode((*frame)->m_coefficients);
+
+                output.write(0b1111111, 7) // Do the bit alignment of the EOI marker
+                        << 0xFF << 0xD9;
+
+                (*frame)->m_coefficients = {};
+                if (!encoded_frames.push(std::move(*frame))) {
+                    return;
+                }
+            }
+            encoded_frames.close();
+        });
+    });
+    run_stage([&]() {
+        while (const auto frame = encoded_frames.pop()) {
+            (*frame)->m_output.to_file((*frame)->m_output_file_name);
+        }
+    });
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+    if (read_exception) {
+        std::rethrow_exception(read_exception);
+    }
+}
 
-    // Write Headers
+void Encoder::write_headers(Output & output, const implementation::Encoder & encoder, const std::size_t width, const std::size_t height)
+{
+    if (encoder.m_grayscale) {
+        write_grayscale_headers(output, encoder, width, height);
+        return;
+    }
 
     // clang-format off
     static const Bytes<25> head0{
@@ -32,12 +273,12 @@ bool Encoder::encode(const std::string & file_name, const utils::Image & image,
            << encoder.m_chrominance_quantization_table.get();
 
     // clang-format off
-    static const Bytes<24> head1{
+    const Bytes<24> head1{
             0xFF, 0xC0, // SOF0 (Start of Frame 0) marker
             0x00, 0x11, // Lenght (17)
             0x08, // Precision
-            static_cast<unsigned char>(image.get_height() >> 8), static_cast<unsigned char>(image.get_height() & 0xFF), // Image height
-            static_cast<unsigned char>(image.get_width() >> 8), static_cast<unsigned char>(image.get_width() & 0xFF), // Image width
+            static_cast<unsigned char>(height >> 8), static_cast<unsigned char>(height & 0xFF), // Image height
+            static_cast<unsigned char>(width >> 8), static_cast<unsigned char>(width & 0xFF), // Image width
             0x03, // Channels count
 
             // Channel description
@@ -67,6 +308,7 @@ bool Encoder::encode(const std::string & file_name, const utils::Image & image,
            << constants::chrominance::dc::SPECTRUM << constants::chrominance::dc::VALUES
            << 0x11 // Class: 1_ (AC), table id: _1.
            << constants::chrominance::ac::SPECTRUM << constants::chrominance::ac::VALUES;
+    write_restart_interval(output, encoder);
 
     // clang-format off
     static const Bytes<14> head2{
@@ -94,12 +336,82 @@ bool Encoder::encode(const std::string & file_name, const utils::Image & image,
     output << head2;
 
     output.reset();
-    encoder.encode(image);
+}
 
-    output.write(0b1111111, 7) // Do the bit alignment of the EOI marker
-            << 0xFF << 0xD9;
+void Encoder::write_grayscale_headers(Output & output, const implementation::Encoder & encoder, const std::size_t width, const std::size_t height)
+{
+    // clang-format off
+    static const Bytes<25> head0{
+            0xFF, 0xD8, // SOI (Start of Image) marker
 
-    output.to_file(file_name);
+            0xFF, 0xE0, // APP0	(Application Segment 0) marker
+            0x00, 0x10, // Lenght (16)
+            'J', 'F', 'I', 'F', // JFIF JPEG Image
+            0, 1, 1, 0, 0, 1, 0, 1, 0, 0, // ?
 
-    return true;
+            0xFF, 0xDB, // DQT (Define Quantization Table) marker
+            0x00, 0x43, // Lenght (67)
+            0x00  // 0_ Values length (1 byte), _0 table id
+    };
+    // clang-format on
+
+    output << head0 << encoder.m_luminance_quantization_table.get();
+
+    // clang-format off
+    const Bytes<18> head1{
+            0xFF, 0xC0, // SOF0 (Start of Frame 0) marker
+            0x00, 0x0B, // Lenght (11)
+            0x08, // Precision
+            static_cast<unsigned char>(height >> 8), static_cast<unsigned char>(height & 0xFF), // Image height
+            static_cast<unsigned char>(width >> 8), static_cast<unsigned char>(width & 0xFF), // Image width
+            0x01, // Channels count
+
+            // Channel description
+            0x01, // Channel id
+            0x11, // Subsampling
+            0x00, // Quantization table id
+
+            0xFF, 0xC4, // DHT marker (Huffman tables)
+            0x00, 0xD2, // Lenght (210)
+            0x00 // Class: 0_ (DC), table id: _0.
+    };
+    // clang-format on
+    output << head1 << constants::luminance::dc::SPECTRUM << constants::luminance::dc::VALUES
+           << 0x10 // Class: 1_ (AC), table id: _0.
+           << constants::luminance::ac::SPECTRUM << constants::luminance::ac::VALUES;
+    write_restart_interval(output, encoder);
+
+    // clang-format off
+    static const Bytes<10> head2{
+            0xFF, 0xDA, // SOS (Start of Scan) marker
+            0x00, 0x08, // Length (8)
+            0x01, // Channels count (1)
+
+            0x01, // Channel id
+            0x00, // Huffman table for DC coefficients: 0_,
+                  // Huffman table for AC coefficients: _0.
+
+            0x00, // Start of spectral or predictor selection
+            0x3F, // End of spectral selection
+            0x00  // Successive approximation bit position
+    };
+    // clang-format on
+    output << head2;
+
+    output.reset();
+}
+
+void Encoder::write_restart_interval(Output & output, const implementation::Encoder & encoder)
+{
+    if (encoder.m_restart_interval == 0) {
+        return;
+    }
+    // clang-format off
+    const Bytes<6> dri{
+            0xFF, 0xDD, // DRI (Define Restart Interval) marker
+            0x00, 0x04, // Lenght (4)
+            static_cast<unsigned char>(encoder.m_restart_interval >> 8), static_cast<unsigned char>(encoder.m_restart_interval & 0xFF)
+    };
+    // clang-format on
+    output << dri;
 }
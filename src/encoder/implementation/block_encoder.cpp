@@ -15,10 +15,19 @@ BlockEncoder::BlockEncoder(const utils::QuantizationTable & quantization_table,
 void BlockEncoder::encode(std::array<float, 64> & block)
 {
     utils::DiscreteCosineTransform::forward(block);
+    encode_coefficients(block);
+}
 
-    const auto quantized = m_quantization_table.forward(block);
+void BlockEncoder::encode_coefficients(const std::array<float, 64> & coefficients)
+{
+    const auto quantized = m_quantization_table.forward(coefficients);
 
     m_last_dc = m_huffman.encode(quantized, m_last_dc, m_output);
 }
 
+void BlockEncoder::reset()
+{
+    m_last_dc = 0;
+}
+
 } // namespace implementation
@@ -2,24 +2,35 @@
 
 #include "encoder/constants.hpp"
 #include "encoder/implementation/y_cb_cr_block.hpp"
+#include "utils/discrete_cosine_transform.hpp"
 #include "utils/image.hpp"
 
 namespace implementation {
 
-Encoder::Encoder(const std::size_t quality, Output & output)
-    : m_subsample(quality <= 90)
-    , m_quality(quality < 50 ? 5000 / quality : 200 - quality * 2)
+Encoder::Encoder(const std::size_t quality,
+                 const std::size_t components_count,
+                 const std::optional<bool> subsample,
+                 const std::size_t restart_interval,
+                 Output & output)
+    : m_grayscale(components_count == 1)
+    , m_subsample(!m_grayscale && subsample.value_or(quality <= 90))
+    , m_quality(utils::QuantizationTable::get_scale(quality))
+    , m_restart_interval(restart_interval)
     , m_luminance_quantization_table(constants::luminance::QUANTIZATION_TABLE, m_quality)
     , m_chrominance_quantization_table(constants::chrominance::QUANTIZATION_TABLE, m_quality)
     , m_luminance_encoder(m_luminance_quantization_table, constants::luminance::HUFFMAN_CODE, output)
     , m_chrominance_blue_encoder(m_chrominance_quantization_table, constants::chrominance::HUFFMAN_CODE, output)
     , m_chrominance_red_encoder(m_chrominance_quantization_table, constants::chrominance::HUFFMAN_CODE, output)
+    , m_output(output)
 {
 }
 
 void Encoder::encode(const utils::Image & image)
 {
-    if (m_subsample) {
+    if (m_grayscale) {
+        encode_grayscale(image);
+    }
+    else if (m_subsample) {
         encode<2>(image);
     }
     else {
@@ -27,12 +38,48 @@ void Encoder::encode(const utils::Image & image)
     }
 }
 
+Encoder::Coefficients Encoder::transform(const utils::Image & image) const
+{
+    Coefficients coefficients;
+    if (m_grayscale) {
+        transform_grayscale(image, coefficients);
+    }
+    else if (m_subsample) {
+        transform<2>(image, coefficients);
+    }
+    else {
+        transform<1>(image, coefficients);
+    }
+    return coefficients;
+}
+
+void Encoder::encode(const Coefficients & coefficients)
+{
+    const std::size_t luminance_blocks_count = m_subsample ? 4 : 1;
+    for (auto it = coefficients.begin(); it != coefficients.end();) {
+        start_mcu();
+        for (std::size_t i = 0; i < luminance_blocks_count; ++i) {
+            m_luminance_encoder.encode_coefficients(*it++);
+        }
+        if (!m_grayscale) {
+            m_chrominance_blue_encoder.encode_coefficients(*it++);
+            m_chrominance_red_encoder.encode_coefficients(*it++);
+        }
+    }
+}
+
+std::size_t Encoder::get_mcu_height() const
+{
+    return m_subsample ? 16 : 8;
+}
+
 template <std::size_t Scaling>
 void Encoder::encode(const utils::Image & image)
 {
     static constexpr std::size_t Stride = 8 * Scaling;
     for (std::size_t x = 0; x < image.get_height(); x += Stride) {
         for (std::size_t y = 0; y < image.get_width(); y += Stride) {
+            start_mcu();
             implementation::YCbCrBlock<Scaling> block{image, x, y};
             for (auto & y : block.Ys()) {
                 m_luminance_encoder.encode(y);
@@ -43,4 +90,71 @@ void Encoder::encode(const utils::Image & image)
     }
 }
 
+void Encoder::encode_grayscale(const utils::Image & image)
+{
+    std::array<float, 64> block;
+    for (std::size_t x = 0; x < image.get_height(); x += 8) {
+        for (std::size_t y = 0; y < image.get_width(); y += 8) {
+            start_mcu();
+            read_grayscale_block(image, x, y, block);
+            m_luminance_encoder.encode(block);
+        }
+    }
+}
+
+template <std::size_t Scaling>
+void Encoder::transform(const utils::Image & image, Coefficients & coefficients) const
+{
+    static constexpr std::size_t Stride = 8 * Scaling;
+    const auto mcus_count = ((image.get_height() + Stride - 1) / Stride) * ((image.get_width() + Stride - 1) / Stride);
+    coefficients.reserve(mcus_count * (Scaling * Scaling + 2));
+    for (std::size_t x = 0; x < image.get_height(); x += Stride) {
+        for (std::size_t y = 0; y < image.get_width(); y += Stride) {
+            implementation::YCbCrBlock<Scaling> block{image, x, y};
+            for (auto & y : block.Ys()) {
+                utils::DiscreteCosineTransform::forward(y);
+                coefficients.push_back(y);
+            }
+            utils::DiscreteCosineTransform::forward(block.Cb());
+            coefficients.push_back(block.Cb());
+            utils::DiscreteCosineTransform::forward(block.Cr());
+            coefficients.push_back(block.Cr());
+        }
+    }
+}
+
+void Encoder::transform_grayscale(const utils::Image & image, Coefficients & coefficients) const
+{
+    coefficients.reserve(((image.get_height() + 7) / 8) * ((image.get_width() + 7) / 8));
+    std::array<float, 64> block;
+    for (std::size_t x = 0; x < image.get_height(); x += 8) {
+        for (std::size_t y = 0; y < image.get_width(); y += 8) {
+            read_grayscale_block(image, x, y, block);
+            utils::DiscreteCosineTransform::forward(block);
+            coefficients.push_back(block);
+        }
+    }
+}
+
+void Encoder::read_grayscale_block(const utils::Image & image, const std::size_t x, const std::size_t y, std::array<float, 64> & block)
+{
+    for (std::size_t i = 0, k = 0; i < 8; ++i) {
+        for (std::size_t j = 0; j < 8; ++j, ++k) {
+            block[k] = image.get_luminance(x + i, y + j);
+        }
+    }
+}
+
+void Encoder::start_mcu()
+{
+    if (m_restart_interval != 0 && m_mcus_count != 0 && m_mcus_count % m_restart_interval == 0) {
+        const auto rst_number = (m_mcus_count / m_restart_interval - 1) & 7;
+        m_output.align() << 0xFF << static_cast<Byte>(0xD0 | rst_number);
+        m_luminance_encoder.reset();
+        m_chrominance_blue_encoder.reset();
+        m_chrominance_red_encoder.reset();
+    }
+    ++m_mcus_count;
+}
+
 } // namespace implementation
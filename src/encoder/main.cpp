@@ -1,10 +1,71 @@
+#include <algorithm>
 #include <args.hxx>
 #include <encoder/constants.hpp>
 #include <encoder/encoder.hpp>
+#include <filesystem>
 #include <fmt/core.h>
+#include <fstream>
 #include <iostream>
 #include <utils/discrete_cosine_transform.hpp>
 #include <utils/image.hpp>
+#include <utils/image_reader.hpp>
+#include <utils/kernels.hpp>
+
+namespace {
+
+inline static constexpr const char * StandardStream = "-";
+
+std::ifstream open_input(const std::string & file_name)
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening input file: " + file_name);
+    }
+    return file;
+}
+
+std::ofstream open_output(const std::string & file_name)
+{
+    std::ofstream file(file_name, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open output file " + file_name);
+    }
+    return file;
+}
+
+/** Pairs every PPM image of the input directory with a JPEG file of the same name in the output one. */
+std::vector<Encoder::Task> get_batch_tasks(const std::filesystem::path & input_directory, const std::filesystem::path & output_directory)
+{
+    if (!std::filesystem::is_directory(input_directory)) {
+        throw std::invalid_argument("Not a directory: " + input_directory.string());
+    }
+    std::filesystem::create_directories(output_directory);
+    std::vector<Encoder::Task> tasks;
+    for (const auto & entry : std::filesystem::directory_iterator(input_directory)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".ppm") {
+            auto output_path = output_directory / entry.path().filename();
+            output_path.replace_extension(".jpg");
+            tasks.push_back({entry.path().string(), output_path.string()});
+        }
+    }
+    std::sort(tasks.begin(), tasks.end(), [](const auto & lhs, const auto & rhs) { return lhs.m_input_file_name < rhs.m_input_file_name; });
+    return tasks;
+}
+
+void encode_image(const std::string & file_name, const utils::Image & image, const Encoder::Options & options)
+{
+    if (options.m_target_size == 0) {
+        Encoder::encode(file_name, image, options);
+        return;
+    }
+    const auto quality = Encoder::encode_to_size(file_name, image, options);
+    if (!quality.has_value()) {
+        throw std::runtime_error(fmt::format("The image does not fit into {} bytes even with quality 1", options.m_target_size));
+    }
+    std::cout << fmt::format("Encoded with quality {}\n", *quality);
+}
+
+} // namespace
 
 int main(int argc, const char * argv[])
 {
@@ -20,20 +81,68 @@ int main(int argc, const char * argv[])
     args::ValueFlag<std::size_t> components_count(parser, "components_count", "The image colors count", {'c', "components_count"});
 
     args::ValueFlag<std::size_t> quality(parser, "quality", "Encoding quality", {'q', "quality"}, 90);
+    args::ValueFlag<std::string> sampling(parser, "sampling", "Chroma sampling of color images: 444 or 420, by default 420 up to quality 90", {"sampling"});
+    args::ValueFlag<std::size_t> restart_interval(parser, "restart_interval", "Number of MCUs between RST markers, 0 means no markers", {"restart-interval"}, 0);
+    args::ValueFlag<std::size_t> target_size(parser, "target_size", "The maximum size of the file in bytes, the best quality fitting it is used instead of --quality", {"target-size"}, 0);
+
+    args::Flag stream(parser, "stream", "Read and encode the image band by band, '-' means stdin/stdout", {'s', "stream"});
+    args::Flag batch(parser, "batch", "Encode every PPM image of the input directory into the output directory with pipelined stages", {"batch"});
+    args::ValueFlag<std::size_t> queue_capacity(parser, "queue_capacity", "The number of images waiting between two stages of the batch encoding", {"queue-capacity"}, 2);
+    args::ValueFlag<std::string> isa(parser, "isa", "Use the kernels built for the instruction set: scalar, sse4.2, avx2 or avx512", {"force-isa"});
 
     try {
         parser.ParseCLI(argc, argv);
 
-        if (!width || !height || !components_count) {
+        if (isa) {
+            utils::force_isa(utils::parse_isa(args::get(isa)));
+        }
+
+        Encoder::Options options;
+        options.m_quality = static_cast<int>(args::get(quality));
+        options.m_restart_interval = args::get(restart_interval);
+        options.m_target_size = args::get(target_size);
+        if (sampling) {
+            if (args::get(sampling) != "444" && args::get(sampling) != "420") {
+                throw std::invalid_argument("Unsupported sampling: " + args::get(sampling));
+            }
+            options.m_subsample = args::get(sampling) == "420";
+        }
+
+        if (batch) {
+            if (stream) {
+                throw std::invalid_argument("The batch encoding cannot be streamed");
+            }
+            const auto tasks = get_batch_tasks(args::get(input_file_name), args::get(output_file_name));
+            Encoder::encode(tasks, options, args::get(queue_capacity));
+        }
+        else if (stream) {
+            std::ifstream input_file;
+            if (args::get(input_file_name) != StandardStream) {
+                input_file = open_input(args::get(input_file_name));
+            }
+            std::ofstream output_file;
+            if (args::get(output_file_name) != StandardStream) {
+                output_file = open_output(args::get(output_file_name));
+            }
+
+            auto & input = input_file.is_open() ? static_cast<std::istream &>(input_file) : std::cin;
+            auto & output = output_file.is_open() ? static_cast<std::ostream &>(output_file) : std::cout;
+            auto reader = (width && height && components_count)
+                    ? utils::ImageReader(input, args::get(width), args::get(height), args::get(components_count))
+                    : utils::ImageReader::from_ppm(input);
+            Encoder::encode(reader, output, options);
+            output.flush();
+        }
+        else if (!width || !height || !components_count) {
             const auto image = utils::Image::from_ppm(args::get(input_file_name));
-            Encoder::encode(args::get(output_file_name), image, args::get(quality));
+            encode_image(args::get(output_file_name), image, options);
         }
         else {
             const auto image = utils::Image::from_file(args::get(width),
                                                        args::get(height),
                                                        args::get(components_count),
                                                        args::get(input_file_name));
-            Encoder::encode(args::get(output_file_name), image, args::get(quality));
+            encode_image(args::get(output_file_name), image, options);
         }
     }
     catch (args::Help) {
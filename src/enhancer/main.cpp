@@ -0,0 +1,48 @@
+#include <args.hxx>
+#include <iostream>
+#include <utils/image.hpp>
+#include <utils/qecnn.hpp>
+
+int main(int argc, const char * argv[])
+{
+    args::ArgumentParser parser("QE-CNN image enhancer");
+
+    args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+
+    args::ValueFlag<std::string> input_file_name(parser, "input_file_name", "The input .ppm file name", {'i', "input"}, args::Options::Required);
+    args::ValueFlag<std::string> output_file_name(parser, "output_file_name", "The output .ppm file name", {'o', "output"}, args::Options::Required);
+    args::ValueFlag<std::string> model_file_name(parser, "model_file_name", "The checkpoint converted by py/convert_checkpoint.py", {'m', "model"}, args::Options::Required);
+
+    args::ValueFlag<std::size_t> threads_count(parser, "threads", "The number of threads, 0 means all CPU cores", {'t', "threads"}, 0);
+    args::ValueFlag<std::size_t> tile_size(parser, "tile", "The size of the image tile processed at once", {"tile"}, 96);
+
+    try {
+        parser.ParseCLI(argc, argv);
+
+        auto model = utils::QECNN::from_file(args::get(model_file_name));
+        model.set_threads_count(args::get(threads_count)).set_tile_size(args::get(tile_size));
+
+        const auto image = utils::Image::from_ppm(args::get(input_file_name));
+        model.enhance(image).to_ppm(args::get(output_file_name));
+    }
+    catch (args::Help) {
+        std::cout << parser;
+        return 0;
+    }
+    catch (args::ParseError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (args::ValidationError e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+    catch (const std::runtime_error & e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
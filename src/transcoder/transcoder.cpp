@@ -0,0 +1,241 @@
+/**
+ * @file transcoder.cpp
+ * @brief Implementation of the C interface of JPEG Transcoder.
+ */
+
+#include "transcoder/transcoder.h"
+
+#include "decoder/decoder.hpp"
+#include "decoder/decoding_exception.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <new>
+
+namespace {
+
+int to_status(const DecodingException::Reason reason)
+{
+    switch (reason) {
+    case DecodingException::Reason::NO_JPEG:
+        return TRANSCODER_NO_JPEG;
+    case DecodingException::Reason::UNSUPPORTED:
+        return TRANSCODER_UNSUPPORTED;
+    case DecodingException::Reason::SYNTAX_ERROR:
+        return TRANSCODER_SYNTAX_ERROR;
+    default:
+        return TRANSCODER_INTERNAL_ERROR;
+    }
+}
+
+/**
+ * @brief Runs the function converting the exceptions into the status codes,
+ * so they never cross the C interface.
+ */
+template <typename Function>
+int guarded(Function && function) noexcept
+{
+    try {
+        return function();
+    }
+    catch (const DecodingException & e) {
+        return to_status(e.get_reason());
+    }
+    catch (const std::bad_alloc &) {
+        return TRANSCODER_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return TRANSCODER_INTERNAL_ERROR;
+    }
+}
+
+int decode_to_pixels(const unsigned char * jpeg,
+                     const size_t jpeg_size,
+                     const Decoder::Mode mode,
+                     const size_t power,
+                     unsigned char * pixels,
+                     const size_t pixels_capacity,
+                     transcoder_image_info * info)
+{
+    if (jpeg == nullptr || (pixels == nullptr && pixels_capacity != 0)) {
+        return TRANSCODER_INVALID_ARGUMENT;
+    }
+    return guarded([&]() {
+        // The decoder holds the Huffman lookup tables, which are too large for the stack.
+        auto decoder = std::make_unique<Decoder>();
+        decoder->toggle_mode(mode).set_dct_filter(power);
+        decoder->decode(jpeg, jpeg_size);
+
+        if (info != nullptr) {
+            *info = {decoder->get_width(), decoder->get_height(), decoder->is_color_image() ? 3u : 1u};
+        }
+        const auto size = decoder->get_image_size();
+        if (pixels_capacity < size) {
+            return TRANSCODER_BUFFER_TOO_SMALL;
+        }
+        std::copy_n(decoder->get_image().data(), size, pixels);
+        return TRANSCODER_OK;
+    });
+}
+
+int process_residuals(const unsigned char * jpeg,
+                      const size_t jpeg_size,
+                      const Decoder::Mode mode,
+                      const size_t power,
+                      const unsigned char * enhanced,
+                      const transcoder_image_info * enhanced_info,
+                      unsigned char * output,
+                      const size_t output_capacity,
+                      size_t * output_size)
+{
+    if (jpeg == nullptr || enhanced == nullptr || enhanced_info == nullptr || output_size == nullptr ||
+        (output == nullptr && output_capacity != 0)) {
+        return TRANSCODER_INVALID_ARGUMENT;
+    }
+
+    transcoder_image_info info;
+    if (const auto status = transcoder_read_info(jpeg, jpeg_size, &info); status != TRANSCODER_OK) {
+        return status;
+    }
+    if (info.width != enhanced_info->width || info.height != enhanced_info->height ||
+        (enhanced_info->components_count != 1 && enhanced_info->components_count != 3)) {
+        return TRANSCODER_INVALID_ARGUMENT;
+    }
+
+    return guarded([&]() {
+        const auto * enhanced_data = reinterpret_cast<const char *>(enhanced);
+        std::vector<char> data(enhanced_data, enhanced_data + info.width * info.height * enhanced_info->components_count);
+
+        auto decoder = std::make_unique<Decoder>();
+        decoder->toggle_mode(mode)
+                .set_dct_filter(power)
+                .set_enhanced_image(utils::Image(info.width, info.height, enhanced_info->components_count, std::move(data)));
+        decoder->decode(jpeg, jpeg_size);
+
+        const auto & result = decoder->get_output().get();
+        *output_size = result.size();
+        if (output_capacity < result.size()) {
+            return TRANSCODER_BUFFER_TOO_SMALL;
+        }
+        std::copy(result.begin(), result.end(), output);
+        return TRANSCODER_OK;
+    });
+}
+
+} // namespace
+
+extern "C" {
+
+const char * transcoder_status_name(const int status)
+{
+    switch (status) {
+    case TRANSCODER_OK:
+        return "OK";
+    case TRANSCODER_NO_JPEG:
+        return "NO_JPEG";
+    case TRANSCODER_UNSUPPORTED:
+        return "UNSUPPORTED";
+    case TRANSCODER_SYNTAX_ERROR:
+        return "SYNTAX_ERROR";
+    case TRANSCODER_INTERNAL_ERROR:
+        return "INTERNAL_ERROR";
+    case TRANSCODER_INVALID_ARGUMENT:
+        return "INVALID_ARGUMENT";
+    case TRANSCODER_BUFFER_TOO_SMALL:
+        return "BUFFER_TOO_SMALL";
+    case TRANSCODER_OUT_OF_MEMORY:
+        return "OUT_OF_MEMORY";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+int transcoder_read_info(const unsigned char * jpeg, const size_t jpeg_size, transcoder_image_info * info)
+{
+    if (jpeg == nullptr || info == nullptr) {
+        return TRANSCODER_INVALID_ARGUMENT;
+    }
+    if (jpeg_size < 2 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        return TRANSCODER_NO_JPEG;
+    }
+
+    // Walks over the marker segments until the frame header.
+    for (size_t position = 2; position + 4 <= jpeg_size;) {
+        if (jpeg[position] != 0xFF) {
+            return TRANSCODER_SYNTAX_ERROR;
+        }
+        const auto marker = jpeg[position + 1];
+        if (marker == 0xFF) {
+            ++position; // Fill byte
+            continue;
+        }
+        const size_t length = (jpeg[position + 2] << 8) | jpeg[position + 3];
+        if (length < 2 || position + 2 + length > jpeg_size) {
+            return TRANSCODER_SYNTAX_ERROR;
+        }
+        // The baseline and the arithmetic coded frames have the same header
+        if (marker == 0xC0 || marker == 0xC9) {
+            if (length < 8) {
+                return TRANSCODER_SYNTAX_ERROR;
+            }
+            const auto * frame = &jpeg[position + 4];
+            *info = {static_cast<size_t>((frame[3] << 8) | frame[4]), static_cast<size_t>((frame[1] << 8) | frame[2]), frame[5]};
+            return TRANSCODER_OK;
+        }
+        if ((marker & 0xF0) == 0xC0 && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            return TRANSCODER_UNSUPPORTED;
+        }
+        if (marker == 0xDA) {
+            return TRANSCODER_SYNTAX_ERROR;
+        }
+        position += 2 + length;
+    }
+    return TRANSCODER_SYNTAX_ERROR;
+}
+
+int transcoder_decode(const unsigned char * jpeg,
+                      const size_t jpeg_size,
+                      unsigned char * pixels,
+                      const size_t pixels_capacity,
+                      transcoder_image_info * info)
+{
+    return decode_to_pixels(jpeg, jpeg_size, Decoder::Mode::DEFAULT, 0, pixels, pixels_capacity, info);
+}
+
+int transcoder_zero_out_and_decode(const unsigned char * jpeg,
+                                   const size_t jpeg_size,
+                                   const size_t power,
+                                   unsigned char * pixels,
+                                   const size_t pixels_capacity,
+                                   transcoder_image_info * info)
+{
+    return decode_to_pixels(jpeg, jpeg_size, Decoder::Mode::ZERO_OUT_AND_DECODE, power, pixels, pixels_capacity, info);
+}
+
+int transcoder_encode_residuals(const unsigned char * jpeg,
+                                const size_t jpeg_size,
+                                const size_t power,
+                                const unsigned char * enhanced,
+                                const transcoder_image_info * enhanced_info,
+                                unsigned char * output,
+                                const size_t output_capacity,
+                                size_t * output_size)
+{
+    return process_residuals(
+            jpeg, jpeg_size, Decoder::Mode::ENCODE_RESIDUALS, power, enhanced, enhanced_info, output, output_capacity, output_size);
+}
+
+int transcoder_decode_residuals(const unsigned char * jpeg,
+                                const size_t jpeg_size,
+                                const size_t power,
+                                const unsigned char * enhanced,
+                                const transcoder_image_info * enhanced_info,
+                                unsigned char * output,
+                                const size_t output_capacity,
+                                size_t * output_size)
+{
+    return process_residuals(
+            jpeg, jpeg_size, Decoder::Mode::DECODE_RESIDUALS, power, enhanced, enhanced_info, output, output_capacity, output_size);
+}
+
+} // extern "C"
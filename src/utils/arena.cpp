@@ -0,0 +1,123 @@
+#include <utils/arena.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace utils {
+
+namespace {
+
+std::size_t align_up(const std::size_t size, const std::size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+Arena::Arena(Arena && other) noexcept
+    : m_chunks(std::move(other.m_chunks))
+    , m_chunk_used_size(std::exchange(other.m_chunk_used_size, 0))
+    , m_used_size(std::exchange(other.m_used_size, 0))
+    , m_allocations_count(std::exchange(other.m_allocations_count, 0))
+{
+    other.m_chunks.clear();
+}
+
+Arena & Arena::operator=(Arena && other) noexcept
+{
+    if (this != &other) {
+        free_chunks();
+        m_chunks = std::move(other.m_chunks);
+        other.m_chunks.clear();
+        m_chunk_used_size = std::exchange(other.m_chunk_used_size, 0);
+        m_used_size = std::exchange(other.m_used_size, 0);
+        m_allocations_count = std::exchange(other.m_allocations_count, 0);
+    }
+    return *this;
+}
+
+Arena::~Arena()
+{
+    free_chunks();
+}
+
+void Arena::release()
+{
+    if (m_chunks.size() > 1) {
+        std::size_t capacity = 0;
+        for (const auto & chunk : m_chunks) {
+            capacity += chunk.m_size;
+        }
+        free_chunks();
+        add_chunk(capacity);
+    }
+    m_chunk_used_size = 0;
+    m_used_size = 0;
+}
+
+std::size_t Arena::get_allocations_count() const
+{
+    return m_allocations_count;
+}
+
+std::size_t Arena::get_used_size() const
+{
+    return m_used_size;
+}
+
+void * Arena::do_allocate(const std::size_t bytes, const std::size_t alignment)
+{
+    if (alignment > Alignment) {
+        throw std::bad_alloc();
+    }
+    const auto size = align_up(std::max<std::size_t>(bytes, 1), Alignment);
+    if (m_chunks.empty() || m_chunk_used_size + size > m_chunks.back().m_size) {
+        // The chunks grow geometrically, as the vectors they replace did.
+        add_chunk(std::max({size, MinChunkSize, m_chunks.empty() ? 0 : 2 * m_chunks.back().m_size}));
+    }
+    auto * pointer = m_chunks.back().m_data + m_chunk_used_size;
+    m_chunk_used_size += size;
+    m_used_size += size;
+    return pointer;
+}
+
+void Arena::do_deallocate(void *, std::size_t, std::size_t)
+{
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource & other) const noexcept
+{
+    return this == &other;
+}
+
+void Arena::add_chunk(const std::size_t size)
+{
+    auto * data = static_cast<Byte *>(::operator new(size, std::align_val_t{Alignment}));
+    m_chunks.push_back({data, size});
+    m_chunk_used_size = 0;
+    ++m_allocations_count;
+}
+
+void Arena::free_chunks()
+{
+    for (const auto & chunk : m_chunks) {
+        ::operator delete(chunk.m_data, std::align_val_t{Alignment});
+    }
+    m_chunks.clear();
+}
+
+Plane::Plane(const std::size_t size, Arena & arena)
+    : m_data(static_cast<Byte *>(arena.allocate(size, Arena::Alignment)))
+    , m_size(size)
+{
+}
+
+void Plane::erase_front(const std::size_t count)
+{
+    std::memmove(m_data, m_data + count, m_size - count);
+    m_size -= count;
+}
+
+} // namespace utils
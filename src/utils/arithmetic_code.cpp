@@ -0,0 +1,211 @@
+#include "utils/arithmetic_code.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace utils {
+
+namespace {
+
+inline static constexpr std::uint32_t TopValue = 1 << 24;
+
+struct EncodingCoder
+{
+    ArithmeticEncoder & m_encoder;
+
+    bool code(const bool bit, Probability & probability)
+    {
+        m_encoder.encode(bit, probability);
+        return bit;
+    }
+};
+
+struct DecodingCoder
+{
+    ArithmeticDecoder & m_decoder;
+
+    bool code(const bool, Probability & probability)
+    {
+        return m_decoder.decode(probability);
+    }
+};
+
+} // namespace
+
+ArithmeticEncoder::ArithmeticEncoder(Output & output)
+    : m_output(&output)
+{
+}
+
+void ArithmeticEncoder::encode(const bool bit, Probability & probability)
+{
+    const auto bound = (m_range >> Probability::Bits) * probability.get();
+    if (bit) {
+        m_low += bound;
+        m_range -= bound;
+    }
+    else {
+        m_range = bound;
+    }
+    probability.update(bit);
+    while (m_range < TopValue) {
+        m_range <<= 8;
+        shift_low();
+    }
+}
+
+void ArithmeticEncoder::finish()
+{
+    for (std::size_t i = 0; i < 5; ++i) {
+        shift_low();
+    }
+}
+
+void ArithmeticEncoder::shift_low()
+{
+    if (static_cast<std::uint32_t>(m_low) < 0xFF000000 || (m_low >> 32) != 0) {
+        const auto carry = static_cast<Byte>(m_low >> 32);
+        auto byte = m_cache;
+        do {
+            const Byte value = byte + carry;
+            *m_output << value;
+            if (value == 0xFF) {
+                *m_output << static_cast<Byte>(0x00);
+            }
+            byte = 0xFF;
+        } while (--m_cache_size != 0);
+        m_cache = static_cast<Byte>(m_low >> 24);
+    }
+    ++m_cache_size;
+    m_low = (m_low & 0x00FFFFFF) << 8;
+}
+
+ArithmeticDecoder::ArithmeticDecoder(std::function<Byte()> next_byte)
+    : m_next_byte(std::move(next_byte))
+{
+    for (std::size_t i = 0; i < 5; ++i) {
+        m_code = (m_code << 8) | m_next_byte();
+    }
+}
+
+bool ArithmeticDecoder::decode(Probability & probability)
+{
+    const auto bound = (m_range >> Probability::Bits) * probability.get();
+    const bool bit = m_code >= bound;
+    if (bit) {
+        m_code -= bound;
+        m_range -= bound;
+    }
+    else {
+        m_range = bound;
+    }
+    probability.update(bit);
+    while (m_range < TopValue) {
+        m_range <<= 8;
+        m_code = (m_code << 8) | m_next_byte();
+    }
+    return bit;
+}
+
+void ArithmeticCode::encode(const std::array<int, 64> & block, const int last_dc, const Mask & mask, ArithmeticEncoder & encoder)
+{
+    auto copy = block;
+    EncodingCoder coder{encoder};
+    code_block(copy, last_dc, [&mask](const std::array<int, 64> &) -> const Mask & { return mask; }, coder);
+}
+
+std::array<int, 64> ArithmeticCode::decode(const int last_dc, const MaskProvider & mask_provider, ArithmeticDecoder & decoder)
+{
+    std::array<int, 64> block;
+    block.fill(0);
+    DecodingCoder coder{decoder};
+    code_block(block, last_dc, mask_provider, coder);
+    return block;
+}
+
+std::size_t ArithmeticCode::get_band(const std::size_t position)
+{
+    if (position < ProtectedCount) {
+        return 0;
+    }
+    return position < 15 ? 1 : (position < 36 ? 2 : 3);
+}
+
+template <class Coder>
+int ArithmeticCode::code_value(const int value, MagnitudeContexts & magnitude, Probability & zero, Probability & sign, Coder & coder)
+{
+    if (!coder.code(value != 0, zero)) {
+        return 0;
+    }
+    return code_nonzero(value, magnitude, sign, coder);
+}
+
+template <class Coder>
+int ArithmeticCode::code_nonzero(const int value, MagnitudeContexts & magnitude, Probability & sign, Coder & coder)
+{
+    const bool is_negative = coder.code(value < 0, sign);
+
+    // Exponent in unary code, then the bits below the leading one
+    const auto absolute = static_cast<std::uint32_t>(std::abs(value));
+    std::size_t exponent = 0;
+    while (exponent + 1 < MagnitudeBits && coder.code((absolute >> (exponent + 1)) != 0, magnitude.m_exponent[exponent])) {
+        ++exponent;
+    }
+    std::uint32_t result = 1;
+    for (std::size_t bit = exponent; bit-- > 0;) {
+        result = (result << 1) | coder.code((absolute >> bit) & 1, magnitude.m_mantissa[exponent][bit]);
+    }
+    return is_negative ? -static_cast<int>(result) : static_cast<int>(result);
+}
+
+template <class Coder>
+void ArithmeticCode::code_block(std::array<int, 64> & block, const int last_dc, const MaskProvider & mask_provider, Coder & coder)
+{
+    // DC
+    const auto dc_context = m_is_last_dc_difference_zero ? 0 : 1;
+    const auto dc_difference = code_value(block[0] - last_dc, m_dc_magnitude[dc_context], m_dc_zero[dc_context], m_dc_sign[dc_context], coder);
+    block[0] = last_dc + dc_difference;
+    m_is_last_dc_difference_zero = dc_difference == 0;
+
+    // AC
+    const Mask * mask = nullptr;
+    const auto is_zeroed_out = [&](const std::size_t i) {
+        if (i < ProtectedCount) {
+            return false;
+        }
+        if (mask == nullptr) {
+            mask = &mask_provider(block);
+        }
+        return !(*mask)[i];
+    };
+
+    std::array<std::size_t, 65> previous_remaining{};
+    for (std::size_t i = 64; i-- > 0;) {
+        previous_remaining[i] = previous_remaining[i + 1] + (m_previous_block[i] != 0);
+    }
+    std::size_t last_nonzero = 0;
+    for (std::size_t i = 1; i < 64; ++i) {
+        if (block[i] != 0) {
+            last_nonzero = i;
+        }
+    }
+
+    for (std::size_t i = 1; i < 64; ++i) {
+        const auto neighbour_class = std::min(previous_remaining[i], NeighbourClasses - 1);
+        if (coder.code(i > last_nonzero, m_end_of_block[i][is_zeroed_out(i)][neighbour_class])) {
+            break;
+        }
+        // There is a nonzero coefficient at the position or after it
+        while (i < 63 && !coder.code(block[i] != 0, m_zero[i][is_zeroed_out(i)][m_previous_block[i] != 0])) {
+            ++i;
+        }
+        const auto zeroed_out = is_zeroed_out(i);
+        block[i] = code_nonzero(block[i], m_magnitude[get_band(i)][zeroed_out], m_sign[zeroed_out], coder);
+    }
+
+    // The mask is requested once per block even if it does not affect the contexts
+    is_zeroed_out(ProtectedCount);
+    m_previous_block = block;
+}
+
+} // namespace utils
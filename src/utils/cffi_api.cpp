@@ -1,5 +1,6 @@
 #include <utils/dct_coefficients_filter.hpp>
 #include <utils/discrete_cosine_transform.hpp>
+#include <utils/mask_combination.hpp>
 
 extern "C" {
 void forward_discrete_cosine_transform(float * block)
@@ -16,6 +17,66 @@ unsigned char * inverse_discrete_cosine_transform(int * block)
     return result;
 }
 
+/**
+ * @brief The functions below transform every 8x8 block of N planes H x W
+ * stored contiguously, in place, using the given number of threads (0 means
+ * the number of CPU cores).
+ *
+ * @return 0 on success, -1 if the dimensions are not multiples of 8.
+ */
+int forward_discrete_cosine_transform_planes(float * planes, const size_t count, const size_t height, const size_t width, const size_t threads_count)
+{
+    if (planes == nullptr || height % 8 != 0 || width % 8 != 0) {
+        return -1;
+    }
+    utils::DiscreteCosineTransform::forward(planes, count * height, width, threads_count);
+    return 0;
+}
+
+int inverse_discrete_cosine_transform_planes(float * planes, const size_t count, const size_t height, const size_t width, const size_t threads_count)
+{
+    if (planes == nullptr || height % 8 != 0 || width % 8 != 0) {
+        return -1;
+    }
+    utils::DiscreteCosineTransform::inverse(planes, count * height, width, threads_count);
+    return 0;
+}
+
+int inverse_discrete_cosine_transform_int_planes(int * planes, const size_t count, const size_t height, const size_t width, const size_t threads_count)
+{
+    if (planes == nullptr || height % 8 != 0 || width % 8 != 0) {
+        return -1;
+    }
+    utils::DiscreteCosineTransform::inverse(planes, count * height, width, threads_count);
+    return 0;
+}
+
+/**
+ * @brief Combines the luma DCT coefficients of the original and predicted
+ * images by the masks (see utils::combine_images_with_masks).
+ *
+ * @return 0 on success, -1 if the arguments are invalid.
+ */
+int combine_images_with_masks(const float * original,
+                              const float * predicted,
+                              const size_t count,
+                              const size_t height,
+                              const size_t width,
+                              const unsigned char * subsampled,
+                              const size_t * masks,
+                              const size_t masks_count,
+                              int * output,
+                              const size_t threads_count)
+{
+    if (original == nullptr || predicted == nullptr || subsampled == nullptr || masks == nullptr || output == nullptr ||
+        masks_count == 0 || height % 8 != 0 || width % 8 != 0) {
+        return -1;
+    }
+    const std::vector<utils::Mask> cpp_type_masks(masks, masks + masks_count);
+    utils::combine_images_with_masks(original, predicted, count, height, width, subsampled, cpp_type_masks, output, threads_count);
+    return 0;
+}
+
 size_t get_dct_filter_masks_count(const size_t power)
 {
     return utils::DCTCoefficientsFilter(power).get_masks_count();
@@ -23,13 +84,13 @@ size_t get_dct_filter_masks_count(const size_t power)
 
 size_t * get_dct_filter_masks(const size_t power)
 {
-    utils::DCTCoefficientsFilter filter(power);
+    const utils::DCTCoefficientsFilter filter(power);
     const auto n = filter.get_masks_count();
 
     auto * masks = new size_t[n];
 
     for (std::size_t i = 0; i < n; ++i) {
-        masks[i] = filter.get_mask().to_ulong();
+        masks[i] = filter.get_entry(i).m_mask.to_ulong();
     }
 
     return masks;
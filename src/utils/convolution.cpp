@@ -0,0 +1,197 @@
+#include <fmt/core.h>
+#include <utils/convolution.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+namespace utils {
+
+namespace {
+
+std::uint32_t read_uint32(std::istream & input)
+{
+    std::uint32_t value = 0;
+    if (!input.read(reinterpret_cast<char *>(&value), sizeof(value))) {
+        throw std::runtime_error("Failed to read the model checkpoint properly.");
+    }
+    return value;
+}
+
+std::vector<float> read_floats(std::istream & input, const std::size_t count)
+{
+    std::vector<float> result(count);
+    if (!input.read(reinterpret_cast<char *>(result.data()), count * sizeof(float))) {
+        throw std::runtime_error("Failed to read the model checkpoint properly.");
+    }
+    return result;
+}
+
+} // namespace
+
+void Tensor::resize(const std::size_t height, const std::size_t width, const std::size_t channels)
+{
+    m_height = height;
+    m_width = width;
+    m_channels = channels;
+    m_data.resize(height * width * channels);
+}
+
+float * Tensor::at(const std::size_t row, const std::size_t column)
+{
+    return &m_data[(row * m_width + column) * m_channels];
+}
+
+const float * Tensor::at(const std::size_t row, const std::size_t column) const
+{
+    return &m_data[(row * m_width + column) * m_channels];
+}
+
+Convolution Convolution::from_stream(std::istream & input)
+{
+    const std::size_t input_channels = read_uint32(input);
+    const std::size_t output_channels = read_uint32(input);
+    const std::size_t kernel_size = read_uint32(input);
+    const std::size_t activation_size = read_uint32(input);
+    if (kernel_size % 2 == 0 || (activation_size != 0 && activation_size != 1 && activation_size != output_channels)) {
+        throw std::runtime_error(fmt::format("Unsupported convolution: kernel {}, PReLU parameters {}", kernel_size, activation_size));
+    }
+
+    const auto weights = read_floats(input, output_channels * input_channels * kernel_size * kernel_size);
+    auto biases = read_floats(input, output_channels);
+    auto activation = read_floats(input, activation_size);
+    if (activation_size == 1) {
+        activation.resize(output_channels, activation.front());
+    }
+
+    return {input_channels, output_channels, kernel_size, weights, std::move(biases), std::move(activation)};
+}
+
+Convolution::Convolution(const std::size_t input_channels,
+                         const std::size_t output_channels,
+                         const std::size_t kernel_size,
+                         const std::vector<float> & weights,
+                         std::vector<float> && biases,
+                         std::vector<float> && activation)
+    : m_input_channels(input_channels)
+    , m_output_channels(output_channels)
+    , m_kernel_size(kernel_size)
+    , m_biases(std::move(biases))
+    , m_activation(std::move(activation))
+{
+    const auto blocks_count = (output_channels + OutputBlock - 1) / OutputBlock;
+    const auto kernel_area = kernel_size * kernel_size;
+
+    m_weights.assign(blocks_count * kernel_area * input_channels * OutputBlock, 0.f);
+    for (std::size_t o = 0; o < output_channels; ++o) {
+        const auto block = o / OutputBlock;
+        for (std::size_t i = 0; i < input_channels; ++i) {
+            for (std::size_t k = 0; k < kernel_area; ++k) {
+                const auto packed = ((block * kernel_area + k) * input_channels + i) * OutputBlock + o % OutputBlock;
+                m_weights[packed] = weights[(o * input_channels + i) * kernel_area + k];
+            }
+        }
+    }
+}
+
+std::size_t Convolution::get_input_channels() const
+{
+    return m_input_channels;
+}
+
+std::size_t Convolution::get_output_channels() const
+{
+    return m_output_channels;
+}
+
+std::size_t Convolution::get_radius() const
+{
+    return m_kernel_size / 2;
+}
+
+void Convolution::apply(const std::vector<const Tensor *> & inputs, Tensor & output) const
+{
+    std::size_t channels = 0;
+    for (const auto * input : inputs) {
+        channels += input->m_channels;
+    }
+    if (channels != m_input_channels) {
+        throw std::runtime_error(fmt::format("Convolution expects {} channels, got {}", m_input_channels, channels));
+    }
+
+    const auto & shape = *inputs.front();
+    output.resize(shape.m_height, shape.m_width, m_output_channels);
+
+    for (std::size_t row = 0; row < shape.m_height; ++row) {
+        for (std::size_t column = 0; column < shape.m_width; column += PixelsBlock) {
+            const auto pixels = std::min(PixelsBlock, shape.m_width - column);
+            for (std::size_t block = 0; block * OutputBlock < m_output_channels; ++block) {
+                apply_block(inputs, output, row, column, pixels, block);
+            }
+        }
+    }
+}
+
+void Convolution::apply_block(const std::vector<const Tensor *> & inputs,
+                              Tensor & output,
+                              const std::size_t row,
+                              const std::size_t column,
+                              const std::size_t pixels,
+                              const std::size_t output_block) const
+{
+    const auto first_channel = output_block * OutputBlock;
+    const auto channels = std::min(OutputBlock, m_output_channels - first_channel);
+
+    // The accumulators of the block stay in the registers/L1 cache, and the
+    // innermost loop runs over contiguous output channels, so it is vectorized.
+    std::array<std::array<float, OutputBlock>, PixelsBlock> accumulators{};
+    for (std::size_t p = 0; p < pixels; ++p) {
+        std::copy(m_biases.begin() + first_channel, m_biases.begin() + first_channel + channels, accumulators[p].begin());
+    }
+
+    const auto height = static_cast<std::ptrdiff_t>(output.m_height);
+    const auto width = static_cast<std::ptrdiff_t>(output.m_width);
+    const auto radius = static_cast<std::ptrdiff_t>(get_radius());
+    const auto kernel_area = m_kernel_size * m_kernel_size;
+
+    for (std::size_t ky = 0; ky < m_kernel_size; ++ky) {
+        const auto y = static_cast<std::ptrdiff_t>(row + ky) - radius;
+        if (y < 0 || y >= height) {
+            continue;
+        }
+        for (std::size_t kx = 0; kx < m_kernel_size; ++kx) {
+            const auto * kernel = &m_weights[(output_block * kernel_area + ky * m_kernel_size + kx) * m_input_channels * OutputBlock];
+            for (std::size_t p = 0; p < pixels; ++p) {
+                const auto x = static_cast<std::ptrdiff_t>(column + p + kx) - radius;
+                if (x < 0 || x >= width) {
+                    continue;
+                }
+                auto & accumulator = accumulators[p];
+                const auto * weights = kernel;
+                for (const auto * input : inputs) {
+                    const auto * source = input->at(y, x);
+                    for (std::size_t i = 0; i < input->m_channels; ++i, weights += OutputBlock) {
+                        const auto value = source[i];
+                        for (std::size_t o = 0; o < OutputBlock; ++o) {
+                            accumulator[o] += value * weights[o];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (std::size_t p = 0; p < pixels; ++p) {
+        auto * destination = output.at(row, column + p) + first_channel;
+        for (std::size_t o = 0; o < channels; ++o) {
+            auto value = accumulators[p][o];
+            if (!m_activation.empty() && value < 0) {
+                value *= m_activation[first_channel + o];
+            }
+            destination[o] = value;
+        }
+    }
+}
+
+} // namespace utils
@@ -1,7 +1,11 @@
 #include "utils/dct_coefficients_filter.hpp"
 
+#include <algorithm>
 #include <fmt/format.h>
+#include <map>
+#include <mutex>
 #include <random>
+#include <tuple>
 #include <unordered_set>
 
 namespace utils {
@@ -64,23 +68,112 @@ std::vector<Mask> generate_masks(const std::size_t power, std::size_t count, con
     return std::vector<Mask>(result_set.begin(), result_set.end());
 }
 
+std::shared_ptr<const std::vector<MaskEntry>> get_entries(const std::size_t power, const std::size_t count, const unsigned int seed)
+{
+    static std::mutex mutex;
+    static std::map<std::tuple<std::size_t, std::size_t, unsigned int>, std::shared_ptr<const std::vector<MaskEntry>>> cache;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto & entries = cache[{power, count, seed}];
+    if (!entries) {
+        std::vector<MaskEntry> result;
+        for (const auto & mask : generate_masks(power, count, seed)) {
+            auto & entry = result.emplace_back();
+            entry.m_mask = mask;
+            for (std::size_t i = 0; i < mask.size(); ++i) {
+                if (!mask[i]) {
+                    entry.m_zeroed_positions.push_back(i);
+                }
+            }
+        }
+        entries = std::make_shared<const std::vector<MaskEntry>>(std::move(result));
+    }
+    return entries;
+}
+
 } // namespace
 
+const MaskEntry KeepAllEntry{};
+
+const char * to_string(const BlockClass block_class)
+{
+    switch (block_class) {
+    case BlockClass::FLAT:
+        return "flat";
+    case BlockClass::SMOOTH:
+        return "smooth";
+    case BlockClass::TEXTURED:
+        return "textured";
+    }
+    return "unknown";
+}
+
 DCTCoefficientsFilter::DCTCoefficientsFilter(const std::size_t power, const std::size_t masks_count, const unsigned int seed)
-    : m_masks(generate_masks(power, masks_count, seed))
+    : DCTCoefficientsFilter({power, power, power}, masks_count, seed)
+{
+}
+
+DCTCoefficientsFilter::DCTCoefficientsFilter(const std::array<std::size_t, BlockClassesCount> & powers,
+                                             const std::size_t masks_count,
+                                             const unsigned int seed)
+    : m_powers(powers)
+{
+    for (std::size_t i = 0; i < BlockClassesCount; ++i) {
+        m_entries[i] = get_entries(m_powers[i], masks_count, seed);
+    }
+}
+
+DCTCoefficientsFilter DCTCoefficientsFilter::adaptive(const std::size_t power, const std::size_t masks_count, const unsigned int seed)
+{
+    // The first six coefficients are kept while at most 58 ones are removed,
+    // so the class of the block survives the zeroing.
+    static constexpr std::size_t MaxPower = 58;
+    return DCTCoefficientsFilter({std::min(power + power / 2, MaxPower), std::min(power, MaxPower), power / 2}, masks_count, seed);
+}
+
+BlockClass DCTCoefficientsFilter::classify(const std::array<int, 64> & block)
 {
+    const auto nonzero_count = std::count_if(block.begin() + 1, block.begin() + 6, [](const int x) { return x != 0; });
+    if (nonzero_count == 0) {
+        return BlockClass::FLAT;
+    }
+    return nonzero_count <= 3 ? BlockClass::SMOOTH : BlockClass::TEXTURED;
+}
+
+std::size_t DCTCoefficientsFilter::get_power(const BlockClass block_class) const
+{
+    return m_powers[static_cast<std::size_t>(block_class)];
 }
 
 std::size_t DCTCoefficientsFilter::get_masks_count() const
 {
-    return m_masks.size();
+    return m_entries[static_cast<std::size_t>(BlockClass::SMOOTH)]->size();
 }
 
 Mask DCTCoefficientsFilter::get_mask()
 {
-    const auto mask = m_masks[m_index];
-    m_index = (m_index + 1) % m_masks.size();
-    return mask;
+    return get_entry().m_mask;
+}
+
+const MaskEntry & DCTCoefficientsFilter::get_entry()
+{
+    return get_entry(m_index++);
+}
+
+const MaskEntry & DCTCoefficientsFilter::get_entry(const std::array<int, 64> & block)
+{
+    return get_entry(m_index++, classify(block));
+}
+
+const MaskEntry & DCTCoefficientsFilter::get_entry(const std::size_t block_index, const BlockClass block_class) const
+{
+    const auto & entries = *m_entries[static_cast<std::size_t>(block_class)];
+    return entries[block_index % entries.size()];
+}
+
+void DCTCoefficientsFilter::seek(const std::size_t block_index)
+{
+    m_index = block_index;
 }
 
 } // namespace utils
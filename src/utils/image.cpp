@@ -2,6 +2,7 @@
 #include <fstream>
 #include <iostream>
 #include <utils/image.hpp>
+#include <utils/image_reader.hpp>
 
 namespace utils {
 
@@ -36,17 +37,6 @@ bool is_ppm_file(const std::string & file_name)
     return (file_name.size() >= 4 && file_name.substr(file_name.size() - 4) == ".ppm");
 }
 
-std::size_t get_components_count_by_ppm_format(const std::string & format)
-{
-    if (format == "P5") {
-        return 1;
-    }
-    if (format == "P6") {
-        return 3;
-    }
-    throw std::runtime_error(fmt::format("Unsupported ppm format: '{}'", format));
-}
-
 std::ifstream open_file(const std::string & file_name)
 {
     std::ifstream file(file_name, std::ios::binary);
@@ -56,24 +46,22 @@ std::ifstream open_file(const std::string & file_name)
     return file;
 }
 
-std::vector<char> read_bytes(const std::size_t bytes_count,
-                             std::ifstream & input)
+Image read_all_rows(ImageReader & reader, const std::string & file_name)
 {
-    std::vector<char> buffer;
-    buffer.resize(bytes_count);
-    if (!input.read(buffer.data(), bytes_count)) {
-        throw std::runtime_error("Failed to read input file properly.");
+    auto image = reader.read_rows(reader.get_height());
+    if (!image.has_value()) {
+        throw std::runtime_error("No image rows in input file: " + file_name);
     }
-    return buffer;
+    return std::move(*image);
 }
 
 } // namespace
 
 Image Image::from_file(std::size_t width, std::size_t height, std::size_t components_count, const std::string & file_name)
 {
-    const auto bytes_count = components_count * width * height;
     auto file = open_file(file_name);
-    return {width, height, components_count, read_bytes(bytes_count, file)};
+    ImageReader reader{file, width, height, components_count};
+    return read_all_rows(reader, file_name);
 }
 
 Image Image::from_ppm(const std::string & file_name)
@@ -83,19 +71,19 @@ Image Image::from_ppm(const std::string & file_name)
     }
 
     auto file = open_file(file_name);
+    auto reader = ImageReader::from_ppm(file);
+    return read_all_rows(reader, file_name);
+}
 
-    std::string format;
-    std::size_t width;
-    std::size_t height;
-    std::size_t max_color_value;
-
-    file >> format >> width >> height >> max_color_value;
-    file.ignore(1, '\n');
-
-    std::size_t components_count = get_components_count_by_ppm_format(format);
-    std::size_t bytes_count = width * height * components_count;
-
-    return {width, height, components_count, read_bytes(bytes_count, file)};
+void Image::to_ppm(const std::string & file_name) const
+{
+    std::ofstream file(file_name, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open output file " + file_name);
+    }
+    file << "P" << (m_components_count == 1 ? 5 : 6) << "\n"
+         << m_width << " " << m_height << "\n255\n";
+    file.write(m_data.data(), m_data.size());
 }
 
 std::size_t Image::get_width() const { return m_width; }
@@ -105,15 +93,17 @@ std::size_t Image::get_height() const { return m_height; }
 std::size_t Image::get_components_count() const { return m_components_count; }
 
 Image::RGBPixel Image::get_rgb(const std::size_t row, const std::size_t column) const
+{
+    return get(get_position(row, column));
+}
+
+std::size_t Image::get_position(const std::size_t row, const std::size_t column) const
 {
     // Дополнение блоков, если размеры изображения не кратны размеру блока
     const auto fixed_row = row >= m_height ? m_height - 1 : row;
     const auto fixed_column = column >= m_width ? m_width - 1 : column;
 
-    const auto position =
-            (fixed_row * m_width + fixed_column) * m_components_count;
-
-    return get(position);
+    return (fixed_row * m_width + fixed_column) * m_components_count;
 }
 
 Image::RGBPixel Image::get(const std::size_t position) const
@@ -141,6 +131,14 @@ Image::YUVPixel Image::get_yuv(const std::size_t row, const std::size_t column)
     return to_yuv(get_rgb(row, column));
 }
 
+float Image::get_luminance(const std::size_t row, const std::size_t column) const
+{
+    if (m_components_count == 1) {
+        return static_cast<float>(get_red(get_position(row, column))) - 128;
+    }
+    return get_yuv(row, column).m_luminance;
+}
+
 std::size_t Image::get_red(const std::size_t position) const
 {
     return get(m_red_component, position);
@@ -0,0 +1,67 @@
+#include <fmt/core.h>
+#include <utils/image_reader.hpp>
+
+namespace utils {
+
+namespace {
+
+std::size_t get_components_count_by_ppm_format(const std::string & format)
+{
+    if (format == "P5") {
+        return 1;
+    }
+    if (format == "P6") {
+        return 3;
+    }
+    throw std::runtime_error(fmt::format("Unsupported ppm format: '{}'", format));
+}
+
+} // namespace
+
+ImageReader::ImageReader(std::istream & input, const std::size_t width, const std::size_t height, const std::size_t components_count)
+    : m_input(input)
+    , m_width(width)
+    , m_height(height)
+    , m_components_count(components_count)
+{
+}
+
+ImageReader ImageReader::from_ppm(std::istream & input)
+{
+    std::string format;
+    std::size_t width;
+    std::size_t height;
+    std::size_t max_color_value;
+
+    input >> format >> width >> height >> max_color_value;
+    if (!input) {
+        throw std::runtime_error("Failed to read ppm header.");
+    }
+    input.ignore(1, '\n');
+
+    return {input, width, height, get_components_count_by_ppm_format(format)};
+}
+
+std::size_t ImageReader::get_width() const { return m_width; }
+
+std::size_t ImageReader::get_height() const { return m_height; }
+
+std::size_t ImageReader::get_components_count() const { return m_components_count; }
+
+std::optional<Image> ImageReader::read_rows(const std::size_t rows_count)
+{
+    if (m_rows_read >= m_height) {
+        return std::nullopt;
+    }
+    const auto rows = std::min(rows_count, m_height - m_rows_read);
+
+    std::vector<char> buffer(rows * m_width * m_components_count);
+    if (!m_input.read(buffer.data(), buffer.size())) {
+        throw std::runtime_error("Failed to read input file properly.");
+    }
+    m_rows_read += rows;
+
+    return Image{m_width, rows, m_components_count, std::move(buffer)};
+}
+
+} // namespace utils
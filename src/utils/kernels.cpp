@@ -0,0 +1,506 @@
+/**
+ * @file kernels.cpp
+ * @brief Kernels built for several instruction sets and their dispatch.
+ *
+ * The bodies of the kernels are plain loops inlined into the functions
+ * compiled for every instruction set, where the compiler vectorizes them.
+ * The file is compiled without the contraction of floating point operations,
+ * so the variants using FMA give the same results as the scalar one.
+ */
+
+#include <utils/kernels.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KERNELS_X86
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE inline
+#endif
+
+namespace {
+
+using utils::Isa;
+using utils::Kernels;
+
+/**
+ * @brief AAN DCT algorithm scaling constants.
+ *
+ * @details AAN DCT algorithm scaling constants are defined as follows:
+ * - aan_scale_factors[0] equals 1;
+ * - aan_scale_factors[k] is calculated as cos(k * PI / 16) * sqrt(2) for k
+ * = 1..7.
+ */
+static const float aan_scale_factors[] = {
+        1.000000000f * 2.828427125f,
+        1.387039845f * 2.828427125f,
+        1.306562965f * 2.828427125f,
+        1.175875602f * 2.828427125f,
+        1.000000000f * 2.828427125f,
+        0.785694958f * 2.828427125f,
+        0.541196100f * 2.828427125f,
+        0.275899379f * 2.828427125f};
+
+/**
+ * @brief Implements the forward discrete cosine transform (DCT).
+ */
+KERNEL_INLINE void forward_transform(float & d0, float & d1, float & d2, float & d3, float & d4, float & d5, float & d6, float & d7)
+{
+    const auto x0 = d0 + d7;
+    const auto x7 = d0 - d7;
+    const auto x1 = d1 + d6;
+    const auto x6 = d1 - d6;
+    const auto x2 = d2 + d5;
+    const auto x5 = d2 - d5;
+    const auto x3 = d3 + d4;
+    const auto x4 = d3 - d4;
+
+    // Even part
+    auto x10 = x0 + x3; // phase 2
+    const auto tmp13 = x0 - x3;
+    auto x11 = x1 + x2;
+    auto x12 = x1 - x2;
+
+    d0 = x10 + x11; // phase 3
+    d4 = x10 - x11;
+
+    const auto z1 = (x12 + tmp13) * 0.707106781f; // c4
+    d2 = tmp13 + z1;                              // phase 5
+    d6 = tmp13 - z1;
+
+    // Odd part
+    x10 = x4 + x5; // phase 2
+    x11 = x5 + x6;
+    x12 = x6 + x7;
+
+    // The rotator is modified from fig 4-8 to avoid extra negations.
+    const auto z5 = (x10 - x12) * 0.382683433f; // c6
+    const auto z2 = x10 * 0.541196100f + z5;    // c2-c6
+    const auto z4 = x12 * 1.306562965f + z5;    // c2+c6
+    const auto z3 = x11 * 0.707106781f;         // c4
+
+    const auto z11 = x7 + z3; // phase 5
+    const auto z13 = x7 - z3;
+
+    d5 = z13 + z2; // phase 6
+    d3 = z13 - z2;
+    d1 = z11 + z4;
+    d7 = z11 - z4;
+}
+
+KERNEL_INLINE void forward_dct(std::array<float, 64> & block)
+{
+    // Application of discrete cosine transformation by rows.
+    for (std::size_t i = 0; i < 64; i += 8) {
+        forward_transform(block[i + 0], block[i + 1], block[i + 2], block[i + 3], block[i + 4], block[i + 5], block[i + 6], block[i + 7]);
+    }
+
+    // Application of discrete cosine transformation by columns
+    for (std::size_t i = 0; i < 8; ++i) {
+        forward_transform(block[i + 0], block[i + 8], block[i + 16], block[i + 24], block[i + 32], block[i + 40], block[i + 48], block[i + 56]);
+    }
+
+    // Descale the DCT coefficients
+    for (std::size_t y = 0, j = 0; y < 8; ++y) {
+        for (std::size_t x = 0; x < 8; ++x, ++j) {
+            block[j] /= aan_scale_factors[y] * aan_scale_factors[x];
+        }
+    }
+}
+
+// Inverse transform constants
+inline static constexpr int W1 = 2841;
+inline static constexpr int W2 = 2676;
+inline static constexpr int W3 = 2408;
+inline static constexpr int W5 = 1609;
+inline static constexpr int W6 = 1108;
+inline static constexpr int W7 = 565;
+
+KERNEL_INLINE unsigned char clip(const int x)
+{
+    return static_cast<unsigned char>(std::clamp(x, 0, 0xFF));
+}
+
+KERNEL_INLINE void inverse_rows_transform(int * block)
+{
+    int x1 = block[4] << 11;
+    int x2 = block[6];
+    int x3 = block[2];
+    int x4 = block[1];
+    int x5 = block[7];
+    int x6 = block[5];
+    int x7 = block[3];
+
+    if ((x1 | x2 | x3 | x4 | x5 | x6 | x7) == 0) {
+        block[0] = block[1] = block[2] = block[3] = block[4] = block[5] = block[6] = block[7] = block[0]
+                << 3;
+        return;
+    }
+
+    int x0 = (block[0] << 11) + 128;
+    int x8 = W7 * (x4 + x5);
+    x4 = x8 + (W1 - W7) * x4;
+    x5 = x8 - (W1 + W7) * x5;
+    x8 = W3 * (x6 + x7);
+    x6 = x8 - (W3 - W5) * x6;
+    x7 = x8 - (W3 + W5) * x7;
+    x8 = x0 + x1;
+    x0 -= x1;
+    x1 = W6 * (x3 + x2);
+    x2 = x1 - (W2 + W6) * x2;
+    x3 = x1 + (W2 - W6) * x3;
+    x1 = x4 + x6;
+    x4 -= x6;
+    x6 = x5 + x7;
+    x5 -= x7;
+    x7 = x8 + x3;
+    x8 -= x3;
+    x3 = x0 + x2;
+    x0 -= x2;
+    x2 = (181 * (x4 + x5) + 128) >> 8;
+    x4 = (181 * (x4 - x5) + 128) >> 8;
+
+    block[0] = (x7 + x1) >> 8;
+    block[1] = (x3 + x2) >> 8;
+    block[2] = (x0 + x4) >> 8;
+    block[3] = (x8 + x6) >> 8;
+    block[4] = (x8 - x6) >> 8;
+    block[5] = (x0 - x4) >> 8;
+    block[6] = (x3 - x2) >> 8;
+    block[7] = (x7 - x1) >> 8;
+}
+
+KERNEL_INLINE void inverse_column_transform(const int * blk, int stride, unsigned char * out)
+{
+    int x0, x1, x2, x3, x4, x5, x6, x7, x8;
+    if (!((x1 = blk[8 * 4] << 8) | (x2 = blk[8 * 6]) | (x3 = blk[8 * 2]) | (x4 = blk[8 * 1]) |
+          (x5 = blk[8 * 7]) | (x6 = blk[8 * 5]) | (x7 = blk[8 * 3]))) {
+        x1 = clip(((blk[0] + 32) >> 6) + 128);
+        for (x0 = 8; x0; --x0) {
+            *out = (unsigned char)x1;
+            out += stride;
+        }
+        return;
+    }
+    x0 = (blk[0] << 8) + 8192;
+    x8 = W7 * (x4 + x5) + 4;
+    x4 = (x8 + (W1 - W7) * x4) >> 3;
+    x5 = (x8 - (W1 + W7) * x5) >> 3;
+    x8 = W3 * (x6 + x7) + 4;
+    x6 = (x8 - (W3 - W5) * x6) >> 3;
+    x7 = (x8 - (W3 + W5) * x7) >> 3;
+    x8 = x0 + x1;
+    x0 -= x1;
+    x1 = W6 * (x3 + x2) + 4;
+    x2 = (x1 - (W2 + W6) * x2) >> 3;
+    x3 = (x1 + (W2 - W6) * x3) >> 3;
+    x1 = x4 + x6;
+    x4 -= x6;
+    x6 = x5 + x7;
+    x5 -= x7;
+    x7 = x8 + x3;
+    x8 -= x3;
+    x3 = x0 + x2;
+    x0 -= x2;
+    x2 = (181 * (x4 + x5) + 128) >> 8;
+    x4 = (181 * (x4 - x5) + 128) >> 8;
+    *out = clip(((x7 + x1) >> 14) + 128);
+    out += stride;
+    *out = clip(((x3 + x2) >> 14) + 128);
+    out += stride;
+    *out = clip(((x0 + x4) >> 14) + 128);
+    out += stride;
+    *out = clip(((x8 + x6) >> 14) + 128);
+    out += stride;
+    *out = clip(((x8 - x6) >> 14) + 128);
+    out += stride;
+    *out = clip(((x0 - x4) >> 14) + 128);
+    out += stride;
+    *out = clip(((x3 - x2) >> 14) + 128);
+    out += stride;
+    *out = clip(((x7 - x1) >> 14) + 128);
+}
+
+KERNEL_INLINE void inverse_dct(std::array<int, 64> & block, const int stride, unsigned char * out)
+{
+    for (int i = 0; i < 64; i += 8) {
+        inverse_rows_transform(&block[i]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        inverse_column_transform(&block[i], stride, &out[i]);
+    }
+}
+
+/**
+ * @brief The inverse DCT transforming all the columns at once. The shortcut
+ * for the single columns without AC coefficients gives the same samples,
+ * but prevents the vectorization, so only the blocks having no vertical
+ * frequencies at all take it.
+ */
+KERNEL_INLINE void inverse_dct_by_lanes(std::array<int, 64> & block, const int stride, unsigned char * out)
+{
+    for (int i = 0; i < 64; i += 8) {
+        inverse_rows_transform(&block[i]);
+    }
+    std::array<unsigned char, 64> samples;
+    int vertical = 0;
+    for (int i = 8; i < 64; ++i) {
+        vertical |= block[i];
+    }
+    if (vertical == 0) {
+        for (int i = 0; i < 8; ++i) {
+            samples[i] = clip(((block[i] + 32) >> 6) + 128);
+        }
+        for (int row = 0; row < 8; ++row) {
+            std::memcpy(out + row * stride, samples.data(), 8);
+        }
+        return;
+    }
+    for (int i = 0; i < 8; ++i) {
+        const int * blk = &block[i];
+        int x1 = blk[8 * 4] << 8, x2 = blk[8 * 6], x3 = blk[8 * 2], x4 = blk[8 * 1];
+        int x5 = blk[8 * 7], x6 = blk[8 * 5], x7 = blk[8 * 3];
+        int x0 = (blk[0] << 8) + 8192;
+        int x8 = W7 * (x4 + x5) + 4;
+        x4 = (x8 + (W1 - W7) * x4) >> 3;
+        x5 = (x8 - (W1 + W7) * x5) >> 3;
+        x8 = W3 * (x6 + x7) + 4;
+        x6 = (x8 - (W3 - W5) * x6) >> 3;
+        x7 = (x8 - (W3 + W5) * x7) >> 3;
+        x8 = x0 + x1;
+        x0 -= x1;
+        x1 = W6 * (x3 + x2) + 4;
+        x2 = (x1 - (W2 + W6) * x2) >> 3;
+        x3 = (x1 + (W2 - W6) * x3) >> 3;
+        x1 = x4 + x6;
+        x4 -= x6;
+        x6 = x5 + x7;
+        x5 -= x7;
+        x7 = x8 + x3;
+        x8 -= x3;
+        x3 = x0 + x2;
+        x0 -= x2;
+        x2 = (181 * (x4 + x5) + 128) >> 8;
+        x4 = (181 * (x4 - x5) + 128) >> 8;
+        samples[8 * 0 + i] = clip(((x7 + x1) >> 14) + 128);
+        samples[8 * 1 + i] = clip(((x3 + x2) >> 14) + 128);
+        samples[8 * 2 + i] = clip(((x0 + x4) >> 14) + 128);
+        samples[8 * 3 + i] = clip(((x8 + x6) >> 14) + 128);
+        samples[8 * 4 + i] = clip(((x8 - x6) >> 14) + 128);
+        samples[8 * 5 + i] = clip(((x0 - x4) >> 14) + 128);
+        samples[8 * 6 + i] = clip(((x3 - x2) >> 14) + 128);
+        samples[8 * 7 + i] = clip(((x7 - x1) >> 14) + 128);
+    }
+    for (int row = 0; row < 8; ++row) {
+        std::memcpy(out + row * stride, &samples[row * 8], 8);
+    }
+}
+
+KERNEL_INLINE void quantize(const std::array<float, 64> & block, const std::array<float, 64> & divisors, std::array<int, 64> & out)
+{
+    for (std::size_t i = 0; i < 64; ++i) {
+        const auto v = block[i] / divisors[i];
+        out[i] = static_cast<int>(v < 0 ? std::ceil(v - 0.5f) : std::floor(v + 0.5f));
+    }
+}
+
+KERNEL_INLINE void ycbcr_to_rgb(const Byte * py, const Byte * pcb, const Byte * pcr, Byte * prgb, const std::size_t width)
+{
+    for (std::size_t x = 0; x < width; ++x) {
+        const auto y = py[x] << 8;
+        const auto cb = pcb[x] - 128;
+        const auto cr = pcr[x] - 128;
+        prgb[3 * x + 0] = clip((y + 359 * cr + 128) >> 8);
+        prgb[3 * x + 1] = clip((y - 88 * cb - 183 * cr + 128) >> 8);
+        prgb[3 * x + 2] = clip((y + 454 * cb + 128) >> 8);
+    }
+}
+
+// Coefficients of the cubic upsampling filter
+inline static constexpr int CF4A = -9;
+inline static constexpr int CF4B = 111;
+inline static constexpr int CF4C = 29;
+inline static constexpr int CF4D = -3;
+inline static constexpr int CF3A = 28;
+inline static constexpr int CF3B = 109;
+inline static constexpr int CF3C = -9;
+inline static constexpr int CF3X = 104;
+inline static constexpr int CF3Y = 27;
+inline static constexpr int CF3Z = -3;
+inline static constexpr int CF2A = 139;
+inline static constexpr int CF2B = -11;
+
+KERNEL_INLINE unsigned char descale(const int x)
+{
+    return clip((x + 64) >> 7);
+}
+
+KERNEL_INLINE void upsample_row(const Byte * lin, const std::size_t width, const std::size_t stride, Byte * lout)
+{
+    lout[0] = descale(CF2A * lin[0] + CF2B * lin[1]);
+    lout[1] = descale(CF3X * lin[0] + CF3Y * lin[1] + CF3Z * lin[2]);
+    lout[2] = descale(CF3A * lin[0] + CF3B * lin[1] + CF3C * lin[2]);
+    for (std::size_t x = 0; x + 3 < width; ++x) {
+        lout[(x << 1) + 3] = descale(CF4A * lin[x] + CF4B * lin[x + 1] + CF4C * lin[x + 2] + CF4D * lin[x + 3]);
+        lout[(x << 1) + 4] = descale(CF4D * lin[x] + CF4C * lin[x + 1] + CF4B * lin[x + 2] + CF4A * lin[x + 3]);
+    }
+    lin += stride;
+    lout += width << 1;
+    lout[-3] = descale(CF3A * lin[-1] + CF3B * lin[-2] + CF3C * lin[-3]);
+    lout[-2] = descale(CF3X * lin[-1] + CF3Y * lin[-2] + CF3Z * lin[-3]);
+    lout[-1] = descale(CF2A * lin[-1] + CF2B * lin[-2]);
+}
+
+KERNEL_INLINE void filter_rows(const Byte * a, const Byte * b, const Byte * c, const Byte * d, const std::array<int, 4> & weights, Byte * out, const std::size_t width)
+{
+    const auto [wa, wb, wc, wd] = weights;
+    for (std::size_t x = 0; x < width; ++x) {
+        out[x] = descale(wa * a[x] + wb * b[x] + wc * c[x] + wd * d[x]);
+    }
+}
+
+/**
+ * @brief Defines the kernels compiled for the instruction set in the namespace
+ * and the table of them.
+ */
+#define DEFINE_KERNELS(isa, target, inverse_dct_body)                                                                                             \
+    namespace isa {                                                                                                                               \
+    target void inverse_dct(std::array<int, 64> & block, int stride, Byte * out)                                                                  \
+    {                                                                                                                                             \
+        inverse_dct_body(block, stride, out);                                                                                                     \
+    }                                                                                                                                             \
+    target void forward_dct(std::array<float, 64> & block)                                                                                        \
+    {                                                                                                                                             \
+        ::forward_dct(block);                                                                                                                     \
+    }                                                                                                                                             \
+    target void quantize(const std::array<float, 64> & block, const std::array<float, 64> & divisors, std::array<int, 64> & out)                \
+    {                                                                                                                                             \
+        ::quantize(block, divisors, out);                                                                                                         \
+    }                                                                                                                                             \
+    target void ycbcr_to_rgb(const Byte * y, const Byte * cb, const Byte * cr, Byte * rgb, std::size_t width)                                     \
+    {                                                                                                                                             \
+        ::ycbcr_to_rgb(y, cb, cr, rgb, width);                                                                                                    \
+    }                                                                                                                                             \
+    target void upsample_row(const Byte * in, std::size_t width, std::size_t stride, Byte * out)                                                  \
+    {                                                                                                                                             \
+        ::upsample_row(in, width, stride, out);                                                                                                   \
+    }                                                                                                                                             \
+    target void filter_rows(const Byte * a, const Byte * b, const Byte * c, const Byte * d, const std::array<int, 4> & weights, Byte * out, std::size_t width) \
+    {                                                                                                                                             \
+        ::filter_rows(a, b, c, d, weights, out, width);                                                                                           \
+    }                                                                                                                                             \
+    inline static constexpr Kernels Table{&inverse_dct, &forward_dct, &quantize, &ycbcr_to_rgb, &upsample_row, &filter_rows};                     \
+    }
+
+DEFINE_KERNELS(scalar, , ::inverse_dct)
+
+#ifdef KERNELS_X86
+DEFINE_KERNELS(sse42, __attribute__((target("sse4.2"))), inverse_dct_by_lanes)
+DEFINE_KERNELS(avx2, __attribute__((target("avx2"))), inverse_dct_by_lanes)
+DEFINE_KERNELS(avx512, __attribute__((target("avx512f,avx512bw,avx512vl"))), inverse_dct_by_lanes)
+#endif
+
+#undef DEFINE_KERNELS
+
+inline static constexpr std::pair<Isa, const char *> IsaNames[] = {
+        {Isa::SCALAR, "scalar"},
+        {Isa::SSE42, "sse4.2"},
+        {Isa::AVX2, "avx2"},
+        {Isa::AVX512, "avx512"},
+};
+
+const Kernels & get_table(const Isa isa)
+{
+    switch (isa) {
+#ifdef KERNELS_X86
+    case Isa::SSE42:
+        return sse42::Table;
+    case Isa::AVX2:
+        return avx2::Table;
+    case Isa::AVX512:
+        return avx512::Table;
+#endif
+    default:
+        return scalar::Table;
+    }
+}
+
+Isa detect_isa()
+{
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+        return Isa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return Isa::SSE42;
+    }
+#endif
+    return Isa::SCALAR;
+}
+
+std::atomic<Isa> & get_current_isa()
+{
+    static std::atomic<Isa> isa{detect_isa()};
+    return isa;
+}
+
+} // namespace
+
+namespace utils {
+
+Isa get_supported_isa()
+{
+    static const auto isa = detect_isa();
+    return isa;
+}
+
+Isa get_isa()
+{
+    return get_current_isa().load(std::memory_order_relaxed);
+}
+
+void force_isa(const Isa isa)
+{
+    if (isa > get_supported_isa()) {
+        throw std::runtime_error(fmt::format("The CPU does not support {} instructions", to_string(isa)));
+    }
+    get_current_isa().store(isa, std::memory_order_relaxed);
+}
+
+const Kernels & get_kernels()
+{
+    return get_table(get_isa());
+}
+
+Isa parse_isa(const std::string & name)
+{
+    for (const auto & [isa, isa_name] : IsaNames) {
+        if (name == isa_name) {
+            return isa;
+        }
+    }
+    throw std::invalid_argument("Unknown instruction set: " + name);
+}
+
+const char * to_string(const Isa isa)
+{
+    for (const auto & [value, name] : IsaNames) {
+        if (value == isa) {
+            return name;
+        }
+    }
+    return "";
+}
+
+} // namespace utils
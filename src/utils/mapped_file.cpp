@@ -0,0 +1,73 @@
+#include "utils/mapped_file.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string & file_name)
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file: " + file_name);
+    }
+    const std::string content(std::istreambuf_iterator<char>(file), {});
+    auto * data = new unsigned char[content.size()];
+    std::copy(content.begin(), content.end(), data);
+    m_data = data;
+    m_size = content.size();
+}
+
+MappedFile::~MappedFile()
+{
+    delete[] m_data;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string & file_name)
+{
+    const int descriptor = open(file_name.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Error opening file: " + file_name);
+    }
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        throw std::runtime_error("Error reading file status: " + file_name);
+    }
+    m_size = static_cast<std::size_t>(status.st_size);
+    // An empty file cannot be mapped, it is left without the data
+    if (m_size > 0) {
+        void * data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data == MAP_FAILED) {
+            close(descriptor);
+            throw std::runtime_error("Error mapping file: " + file_name);
+        }
+        m_data = static_cast<const unsigned char *>(data);
+    }
+    close(descriptor);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data != nullptr) {
+        munmap(const_cast<unsigned char *>(m_data), m_size);
+    }
+}
+
+#endif
+
+} // namespace utils
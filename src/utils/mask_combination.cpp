@@ -0,0 +1,109 @@
+#include <utils/discrete_cosine_transform.hpp>
+#include <utils/mask_combination.hpp>
+#include <utils/parallel.hpp>
+#include <utils/zigzag.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace utils {
+
+namespace {
+
+inline static constexpr std::size_t Channels = 3;
+
+float to_luminance(const float red, const float green, const float blue)
+{
+    return (0.299f * red + 0.587f * green + 0.114f * blue) * 255.f - 128.f;
+}
+
+int to_sample(const float value)
+{
+    return static_cast<int>(std::min(std::max(std::nearbyint(value), 0.f), 255.f));
+}
+
+/**
+ * @brief Index of the luma block in the scan order of the decoder.
+ */
+std::size_t get_block_index(const std::size_t block_row, const std::size_t block_column, const std::size_t width, const bool subsampled)
+{
+    if (!subsampled) {
+        return block_row * (width / 8) + block_column;
+    }
+    const auto mcu_columns = (width + 15) / 16;
+    const auto mcu = (block_row / 2) * mcu_columns + block_column / 2;
+    return mcu * 4 + (block_row % 2) * 2 + block_column % 2;
+}
+
+} // namespace
+
+void combine_images_with_masks(const float * original,
+                               const float * predicted,
+                               const std::size_t count,
+                               const std::size_t height,
+                               const std::size_t width,
+                               const unsigned char * subsampled,
+                               const std::vector<Mask> & masks,
+                               int * output,
+                               const std::size_t threads_count)
+{
+    const auto plane_size = height * width;
+    const auto block_rows = height / 8;
+
+    parallel_for(count * block_rows, threads_count, [&](const std::size_t task) {
+        const auto image = task / block_rows;
+        const auto block_row = task % block_rows;
+
+        const float * original_planes[Channels];
+        const float * predicted_planes[Channels];
+        int * output_planes[Channels];
+        for (std::size_t c = 0; c < Channels; ++c) {
+            original_planes[c] = original + (image * Channels + c) * plane_size;
+            predicted_planes[c] = predicted + (image * Channels + c) * plane_size;
+            output_planes[c] = output + (image * Channels + c) * plane_size;
+        }
+
+        std::array<float, 64> original_block, predicted_block;
+        for (std::size_t block_column = 0; block_column < width / 8; ++block_column) {
+            const auto origin = block_row * 8 * width + block_column * 8;
+            for (std::size_t i = 0, k = 0; i < 8; ++i) {
+                for (std::size_t j = 0; j < 8; ++j, ++k) {
+                    const auto position = origin + i * width + j;
+                    original_block[k] = to_luminance(original_planes[0][position], original_planes[1][position], original_planes[2][position]);
+                    predicted_block[k] = to_luminance(predicted_planes[0][position], predicted_planes[1][position], predicted_planes[2][position]);
+                }
+            }
+
+            DiscreteCosineTransform::forward(original_block);
+            DiscreteCosineTransform::forward(predicted_block);
+
+            const auto & mask = masks[get_block_index(block_row, block_column, width, subsampled[image] != 0) % masks.size()];
+            for (std::size_t i = 0; i < 64; ++i) {
+                if (mask[i]) {
+                    const auto position = REVERSED_ZIGZAG_ORDER[i];
+                    predicted_block[position] = original_block[position];
+                }
+            }
+
+            DiscreteCosineTransform::inverse(predicted_block);
+
+            for (std::size_t i = 0, k = 0; i < 8; ++i) {
+                for (std::size_t j = 0; j < 8; ++j, ++k) {
+                    const auto position = origin + i * width + j;
+                    const auto red = predicted_planes[0][position] * 255.f;
+                    const auto green = predicted_planes[1][position] * 255.f;
+                    const auto blue = predicted_planes[2][position] * 255.f;
+                    const auto luminance = predicted_block[k] + 128.f;
+                    const auto cb = -0.16874f * red - 0.33126f * green + 0.5f * blue;
+                    const auto cr = 0.5f * red - 0.41869f * green - 0.08131f * blue;
+                    output_planes[0][position] = to_sample(luminance + 1.402f * cr);
+                    output_planes[1][position] = to_sample(luminance - 0.344136f * cb - 0.714136f * cr);
+                    output_planes[2][position] = to_sample(luminance + 1.772f * cb);
+                }
+            }
+        }
+    });
+}
+
+} // namespace utils
@@ -2,6 +2,13 @@
 #include <iostream>
 #include <utils/output.hpp>
 
+Output Output::counting()
+{
+    Output output;
+    output.m_is_counting = true;
+    return output;
+}
+
 void Output::to_file(const std::string & file_name) const
 {
     std::ofstream file{file_name, std::ios::binary};
@@ -12,6 +19,16 @@ void Output::to_file(const std::string & file_name) const
     file.close();
 }
 
+void Output::flush(std::ostream & stream)
+{
+    stream.write(reinterpret_cast<const char *>(m_result.data()), m_result.size());
+    if (!stream) {
+        throw std::runtime_error("Cannot write to output stream");
+    }
+    m_result.clear();
+    m_counted_bytes_count = 0;
+}
+
 void Output::reset()
 {
     if (m_bits_buffer != 0 || m_bits_count != 0) {
@@ -21,8 +38,18 @@ void Output::reset()
     m_bits_count = 0;
 }
 
+void Output::clear()
+{
+    m_result.clear();
+    m_counted_bytes_count = 0;
+    m_bits_buffer = 0;
+    m_bits_count = 0;
+}
+
 const std::vector<unsigned char> & Output::get() const { return m_result; }
 
+std::size_t Output::get_bits_count() const { return (m_result.size() + m_counted_bytes_count) * 8 + m_bits_count; }
+
 Output & Output::write(unsigned short code, unsigned short lenght)
 {
     m_bits_count += lenght;
@@ -40,8 +67,21 @@ Output & Output::write(unsigned short code, unsigned short lenght)
     return *this;
 }
 
+Output & Output::align()
+{
+    if (m_bits_count != 0) {
+        const auto padding = 8 - m_bits_count;
+        write((1 << padding) - 1, padding);
+    }
+    return *this;
+}
+
 Output & Output::operator<<(const unsigned char value)
 {
+    if (m_is_counting) {
+        ++m_counted_bytes_count;
+        return *this;
+    }
     m_result.push_back(value);
     return *this;
 }
@@ -0,0 +1,184 @@
+#include <fmt/core.h>
+#include <utils/parallel.hpp>
+#include <utils/qecnn.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace utils {
+
+namespace {
+
+inline static constexpr char Signature[8] = {'Q', 'E', 'C', 'N', 'N', 0, 0, 1};
+
+inline static constexpr std::size_t Channels = 3;
+
+/**
+ * @brief Zeroes the values of the tensor lying outside of the image.
+ *
+ * This makes the padding of each layer at the image borders the same as in
+ * PyTorch, while inside of the image the overlap of the tiles is used.
+ */
+void zero_outside(Tensor & tensor, const std::ptrdiff_t top, const std::ptrdiff_t left, const Image & image)
+{
+    const auto height = static_cast<std::ptrdiff_t>(image.get_height());
+    const auto width = static_cast<std::ptrdiff_t>(image.get_width());
+    for (std::size_t i = 0; i < tensor.m_height; ++i) {
+        const auto row = top + static_cast<std::ptrdiff_t>(i);
+        const bool row_outside = row < 0 || row >= height;
+        for (std::size_t j = 0; j < tensor.m_width; ++j) {
+            const auto column = left + static_cast<std::ptrdiff_t>(j);
+            if (row_outside || column < 0 || column >= width) {
+                std::fill_n(tensor.at(i, j), tensor.m_channels, 0.f);
+            }
+        }
+    }
+}
+
+char to_byte(const float value)
+{
+    const auto scaled = std::floor(value * 255.f + 0.5f);
+    return static_cast<char>(static_cast<unsigned char>(std::min(std::max(scaled, 0.f), 255.f)));
+}
+
+} // namespace
+
+QECNN QECNN::from_file(const std::string & file_name)
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening model file: " + file_name);
+    }
+
+    char signature[sizeof(Signature)];
+    if (!file.read(signature, sizeof(signature)) || std::memcmp(signature, Signature, sizeof(Signature)) != 0) {
+        throw std::runtime_error(fmt::format("Not a converted QE-CNN checkpoint: {}", file_name));
+    }
+
+    QECNN model;
+    for (std::size_t i = 0; i < LayersCount; ++i) {
+        model.m_layers.push_back(Convolution::from_stream(file));
+    }
+    return model;
+}
+
+QECNN & QECNN::set_tile_size(const std::size_t tile_size)
+{
+    m_tile_size = std::max<std::size_t>(tile_size, 1);
+    return *this;
+}
+
+QECNN & QECNN::set_threads_count(const std::size_t threads_count)
+{
+    m_threads_count = threads_count;
+    return *this;
+}
+
+std::size_t QECNN::get_overlap() const
+{
+    // The longest path through the network: conv*1, conv*2, conv*3, conv*4, conv5.
+    std::size_t overlap = 0;
+    for (std::size_t i = 0; i < 4; ++i) {
+        overlap += std::max(m_layers[i].get_radius(), m_layers[i + 4].get_radius());
+    }
+    return overlap + m_layers.back().get_radius();
+}
+
+Image QECNN::enhance(const Image & image) const
+{
+    const auto rows = (image.get_height() + m_tile_size - 1) / m_tile_size;
+    const auto columns = (image.get_width() + m_tile_size - 1) / m_tile_size;
+    const auto tiles_count = rows * columns;
+
+    std::vector<char> result(image.get_width() * image.get_height() * image.get_components_count());
+
+    parallel_for(tiles_count, m_threads_count, [&](const std::size_t tile) {
+        enhance_tile(image, tile / columns * m_tile_size, tile % columns * m_tile_size, result);
+    });
+
+    return {image.get_width(), image.get_height(), image.get_components_count(), std::move(result)};
+}
+
+void QECNN::enhance_tile(const Image & image, const std::size_t row, const std::size_t column, std::vector<char> & result) const
+{
+    const auto overlap = get_overlap();
+    const auto height = std::min(m_tile_size, image.get_height() - row);
+    const auto width = std::min(m_tile_size, image.get_width() - column);
+    const auto top = static_cast<std::ptrdiff_t>(row) - static_cast<std::ptrdiff_t>(overlap);
+    const auto left = static_cast<std::ptrdiff_t>(column) - static_cast<std::ptrdiff_t>(overlap);
+
+    Tensor x;
+    x.resize(height + 2 * overlap, width + 2 * overlap, Channels);
+    for (std::size_t i = 0; i < x.m_height; ++i) {
+        for (std::size_t j = 0; j < x.m_width; ++j) {
+            const auto r = top + static_cast<std::ptrdiff_t>(i);
+            const auto c = left + static_cast<std::ptrdiff_t>(j);
+            if (r < 0 || c < 0 || r >= static_cast<std::ptrdiff_t>(image.get_height()) || c >= static_cast<std::ptrdiff_t>(image.get_width())) {
+                continue;
+            }
+            const auto pixel = image.get_rgb(r, c);
+            auto * value = x.at(i, j);
+            value[0] = pixel.m_red / 255.f;
+            value[1] = pixel.m_green / 255.f;
+            value[2] = pixel.m_blue / 255.f;
+        }
+    }
+
+    const auto & conv11 = m_layers[0];
+    const auto & conv12 = m_layers[1];
+    const auto & conv13 = m_layers[2];
+    const auto & conv14 = m_layers[3];
+    const auto & conv21 = m_layers[4];
+    const auto & conv22 = m_layers[5];
+    const auto & conv23 = m_layers[6];
+    const auto & conv24 = m_layers[7];
+    const auto & conv5 = m_layers[8];
+
+    const auto apply = [&](const Convolution & layer, const std::vector<const Tensor *> & inputs, Tensor & output) {
+        layer.apply(inputs, output);
+        zero_outside(output, top, left, image);
+    };
+
+    Tensor a, y, next_a, next_y;
+    apply(conv11, {&x}, a);
+    apply(conv21, {&x}, y);
+
+    apply(conv12, {&a}, next_a);
+    apply(conv22, {&a, &y}, next_y);
+    std::swap(a, next_a);
+    std::swap(y, next_y);
+
+    apply(conv13, {&a}, next_a);
+    apply(conv23, {&a, &y}, next_y);
+    std::swap(a, next_a);
+    std::swap(y, next_y);
+
+    apply(conv14, {&a}, next_a);
+    apply(conv24, {&a, &y}, next_y);
+
+    Tensor residual;
+    conv5.apply({&next_a, &next_y}, residual);
+
+    const auto components_count = image.get_components_count();
+    for (std::size_t i = 0; i < height; ++i) {
+        for (std::size_t j = 0; j < width; ++j) {
+            const auto * input = x.at(i + overlap, j + overlap);
+            const auto * delta = residual.at(i + overlap, j + overlap);
+            auto * output = &result[((row + i) * image.get_width() + column + j) * components_count];
+            if (components_count == 1) {
+                // Grayscale images are processed as RGB with equal components.
+                const auto luminance = 0.299f * (input[0] + delta[0]) + 0.587f * (input[1] + delta[1]) + 0.114f * (input[2] + delta[2]);
+                output[0] = to_byte(luminance);
+                continue;
+            }
+            for (std::size_t c = 0; c < Channels; ++c) {
+                output[c] = to_byte(input[c] + delta[c]);
+            }
+        }
+    }
+}
+
+} // namespace utils
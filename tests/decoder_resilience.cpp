@@ -0,0 +1,167 @@
+#include "decoder/decoder.hpp"
+#include "encoder/encoder.hpp"
+#include "utils/image_reader.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Third-party:
+#include <fmt/core.h>
+
+/*
+ * Injects a spurious RST marker into the middle of a restart interval and
+ * checks that the error resilient decoding reports the damaged MCUs and keeps
+ * the rest of the image in place.
+ */
+
+namespace {
+
+inline constexpr std::size_t Width = 256;
+inline constexpr std::size_t Height = 128;
+inline constexpr std::size_t RestartInterval = 4;
+// The image is 4:4:4, so an MCU is one block and there is no upsampling across MCUs
+inline constexpr std::size_t McuSize = 8;
+inline constexpr std::size_t McusPerRow = Width / McuSize;
+
+BytesList encode()
+{
+    std::string pixels;
+    for (std::size_t y = 0; y < Height; ++y) {
+        for (std::size_t x = 0; x < Width; ++x) {
+            pixels.push_back(static_cast<char>(x));
+            pixels.push_back(static_cast<char>(y * 2));
+            pixels.push_back(static_cast<char>((x * y) / 64 + ((x ^ y) & 31)));
+        }
+    }
+    std::istringstream input(pixels);
+    utils::ImageReader reader(input, Width, Height, 3);
+
+    Encoder::Options options;
+    options.m_subsample = false;
+    options.m_restart_interval = RestartInterval;
+    std::ostringstream output;
+    Encoder::encode(reader, output, options);
+    const auto bytes = output.str();
+    return {bytes.begin(), bytes.end()};
+}
+
+struct RestartMarker
+{
+    std::size_t m_position;
+    int m_number;
+};
+
+std::vector<RestartMarker> find_restart_markers(const BytesList & jpeg)
+{
+    std::size_t position = 0;
+    while (jpeg[position] != 0xFF || jpeg[position + 1] != 0xDA) {
+        ++position;
+    }
+    position += 2 + ((jpeg[position + 2] << 8) | jpeg[position + 3]);
+
+    std::vector<RestartMarker> markers;
+    for (; position + 1 < jpeg.size(); ++position) {
+        if (jpeg[position] == 0xFF && (jpeg[position + 1] & 0xF8) == 0xD0) {
+            markers.push_back({position, jpeg[position + 1] & 7});
+        }
+    }
+    return markers;
+}
+
+struct Decoded
+{
+    std::vector<Byte> m_pixels;
+    std::vector<Decoder::DamagedRange> m_damaged_ranges;
+};
+
+Decoded decode(const BytesList & jpeg, const bool is_resilient)
+{
+    Decoder decoder;
+    decoder.set_error_resilience(is_resilient);
+    decoder.decode(jpeg);
+    const auto & image = decoder.get_image();
+    return {{image.data(), image.data() + decoder.get_image_size()}, decoder.get_damaged_ranges()};
+}
+
+bool is_damaged(const std::vector<Decoder::DamagedRange> & ranges, const std::size_t mcu)
+{
+    for (const auto & range : ranges) {
+        if (mcu >= range.m_first_mcu && mcu < range.m_first_mcu + range.m_mcus_count) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Writes the marker into the middle of the interval ended by RST7 and
+ * checks that the MCUs out of the reported ranges are decoded as in the intact image.
+ *
+ * @return The damaged ranges.
+ */
+std::vector<Decoder::DamagedRange> check_injected_marker(const BytesList & jpeg, const Decoded & intact, const Byte marker)
+{
+    const auto markers = find_restart_markers(jpeg);
+    std::size_t interval = 1;
+    while (markers[interval].m_number != 7) {
+        ++interval;
+    }
+    auto position = (markers[interval - 1].m_position + markers[interval].m_position) / 2;
+    // A fill byte before the marker would make it the data
+    while (jpeg[position - 1] == 0xFF) {
+        ++position;
+    }
+    auto damaged = jpeg;
+    damaged[position] = 0xFF;
+    damaged[position + 1] = marker;
+
+    const auto decoded = decode(damaged, true);
+    if (!is_damaged(decoded.m_damaged_ranges, interval * RestartInterval)) {
+        throw std::runtime_error(fmt::format("The damaged interval {} is not reported for RST{}", interval, marker & 7));
+    }
+    for (std::size_t y = 0; y < Height; ++y) {
+        for (std::size_t x = 0; x < Width; ++x) {
+            const auto mcu = y / McuSize * McusPerRow + x / McuSize;
+            const auto offset = (y * Width + x) * 3;
+            if (!is_damaged(decoded.m_damaged_ranges, mcu) &&
+                (decoded.m_pixels[offset] != intact.m_pixels[offset] || decoded.m_pixels[offset + 1] != intact.m_pixels[offset + 1] ||
+                 decoded.m_pixels[offset + 2] != intact.m_pixels[offset + 2])) {
+                throw std::runtime_error(fmt::format("MCU {} is not reported as damaged, but differs for RST{}", mcu, marker & 7));
+            }
+        }
+    }
+    return decoded.m_damaged_ranges;
+}
+
+} // namespace
+
+int main()
+{
+    try {
+        const auto jpeg = encode();
+        const auto intact = decode(jpeg, false);
+
+        for (Byte marker = 0xD0; marker <= 0xD7; ++marker) {
+            check_injected_marker(jpeg, intact, marker);
+        }
+
+        // RST3 is four intervals ahead of the expected RST7, so it is not trusted
+        // and only the interval holding it is lost
+        const auto ranges = check_injected_marker(jpeg, intact, 0xD3);
+        std::size_t damaged_mcus_count = 0;
+        for (const auto & range : ranges) {
+            damaged_mcus_count += range.m_mcus_count;
+        }
+        if (damaged_mcus_count != RestartInterval) {
+            throw std::runtime_error(fmt::format("{} MCUs are reported as damaged for RST3 instead of one interval", damaged_mcus_count));
+        }
+    }
+    catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}